@@ -0,0 +1,503 @@
+// Copyright 2021 <lwolmer>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "lw_utils.h"
+
+#define BENCH_MAX_RESULTS 128
+#define BENCH_NAME_LEN 64
+#define BENCH_FILE_LINES 5000
+
+/**
+    @brief Single measured benchmark
+*/
+typedef struct {
+    char name[BENCH_NAME_LEN];  /**< name of the benchmark*/
+    size_t param;  /**< size parameter (elements, digits, lines)*/
+    size_t ops;  /**< total amount of operations done*/
+    double seconds;  /**< total time spent*/
+    double allocs;  /**< allocations per operation*/
+    double bytes;  /**< allocated bytes per operation*/
+} bench_result;
+
+/**
+    @brief Benchmark body, returns amount of operations done during one run
+*/
+typedef size_t (*bench_fn)(size_t param);
+
+// counts allocations done by the library
+static lw_counting_allocator *counter = NULL;
+
+static double min_time = 0.2;
+static char *bench_file = NULL;
+static unsigned int seed = 42;
+// keeps compiler from throwing away results
+static volatile size_t sink = 0;
+
+static double get_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// setup done between bench_pause and bench_resume is excluded from time and allocations of the benchmark
+static double pause_start = 0;
+static lw_mem_stats pause_stats = {0};
+static double paused_seconds = 0;
+static size_t paused_allocations = 0;
+static size_t paused_bytes = 0;
+
+static void bench_pause(void) {
+    pause_stats = lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS);
+    pause_start = get_seconds();
+}
+
+static void bench_resume(void) {
+    paused_seconds += get_seconds() - pause_start;
+    lw_mem_stats stats = lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS);
+    paused_allocations += stats.allocations - pause_stats.allocations;
+    paused_bytes += stats.bytes - pause_stats.bytes;
+}
+
+static void fill_digits(char *str, size_t digits) {
+    for (size_t i = 0; i < digits; i++)
+        str[i] = '0' + rand_r(&seed) % 10;
+    if (digits)
+        str[0] = '1' + rand_r(&seed) % 9;
+    str[digits] = 0;
+}
+
+static list *fill_list(size_t count) {
+    list *lst = NULL;
+    for (size_t i = 0; i < count; i++)
+        list_add(&lst, (void *)i, false);
+    return lst;
+}
+
+static size_t bench_list_add(size_t count) {
+    list *lst = fill_list(count);
+    bench_pause();
+    list_free(&lst);
+    bench_resume();
+    return count;
+}
+
+static size_t bench_list_pop(size_t count) {
+    bench_pause();
+    list *lst = fill_list(count);
+    bench_resume();
+    for (size_t i = 0; i < count; i++)
+        list_pop(&lst);
+    return count;
+}
+
+static size_t bench_list_free(size_t count) {
+    bench_pause();
+    list *lst = fill_list(count);
+    bench_resume();
+    list_free(&lst);
+    return count;
+}
+
+typedef struct {
+    size_t value;
+    ilist_link link;
+} bench_item;
+
+static size_t bench_ilist_add_pop(size_t count) {
+    bench_item *items = malloc(count * sizeof(bench_item));
+    ilist lst;
+    ilist_init(&lst);
+    for (size_t i = 0; i < count; i++) {
+        items[i].value = i;
+        ilist_add(&lst, &items[i].link);
+    }
+    ILIST_FOREACH(link, &lst)
+        sink += LW_CONTAINER_OF(link, bench_item, link)->value;
+    while (ilist_pop(&lst)) {}
+    free(items);
+    return count;
+}
+
+static size_t bench_DS_append_char(size_t count) {
+    dynamic_string *ds = DS_init(NULL);
+    for (size_t i = 0; i < count; i++)
+        DS_append_char(ds, 'a' + i % 26);
+    sink += ds->length;
+    DS_free(ds);
+    return count;
+}
+
+static size_t bench_DS_insert_text(size_t count) {
+    dynamic_string *ds = DS_init("start");
+    for (size_t i = 0; i < count; i++)
+        DS_insert_text(ds, "0123456789", ds->length / 2);
+    sink += ds->length;
+    DS_free(ds);
+    return count;
+}
+
+static dynamic_string *fill_words(size_t words) {
+    dynamic_string *ds = DS_init(NULL);
+    for (size_t i = 0; i < words; i++)
+        DS_insert_text(ds, i % 2 ? "lorem " : "ipsum, ", ds->length);
+    return ds;
+}
+
+static size_t bench_DS_find(size_t words) {
+    bench_pause();
+    dynamic_string *ds = fill_words(words);
+    bench_resume();
+    for (size_t pos = DS_find(ds, "ipsum", 0); pos != DS_NPOS; pos = DS_find(ds, "ipsum", pos + 1))
+        sink += pos;
+    bench_pause();
+    DS_free(ds);
+    bench_resume();
+    return words;
+}
+
+static size_t bench_DS_split(size_t words) {
+    bench_pause();
+    dynamic_string *ds = fill_words(words);
+    string_view *views = malloc(words * sizeof(string_view));
+    bench_resume();
+    sink += DS_split(ds, " ,", true, views, words);
+    bench_pause();
+    free(views);
+    DS_free(ds);
+    bench_resume();
+    return words;
+}
+
+static size_t bench_DS_replace_all(size_t words) {
+    bench_pause();
+    dynamic_string *ds = fill_words(words);
+    bench_resume();
+    DS_replace_all(ds, "lorem", "dolor sit amet");
+    sink += ds->length;
+    bench_pause();
+    DS_free(ds);
+    bench_resume();
+    return words;
+}
+
+static size_t bench_utf8_validate(size_t bytes) {
+    static const char sample[] = "plain text, \xC3\xA9t\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 ";
+    bench_pause();
+    char *text = malloc(bytes);
+    for (size_t i = 0; i < bytes; i++)
+        text[i] = sample[i % (sizeof(sample) - 1)];
+    bench_resume();
+    // cutting possibly incomplete sequence at the end
+    size_t len = bytes - bytes % (sizeof(sample) - 1);
+    sink += utf8_validate(text, len) + utf8_length(text, len);
+    bench_pause();
+    free(text);
+    bench_resume();
+    return bytes;
+}
+
+static size_t bench_multiply_strings(size_t digits) {
+    bench_pause();
+    char *str1 = malloc(digits + 1);
+    char *str2 = malloc(digits + 1);
+    fill_digits(str1, digits);
+    fill_digits(str2, digits);
+    dynamic_string *result = DS_init(NULL);
+    bench_resume();
+    multiply_strings(result, str1, str2);
+    sink += result->length;
+    bench_pause();
+    DS_free(result);
+    free(str1);
+    free(str2);
+    bench_resume();
+    return 1;
+}
+
+static size_t bench_divide_strings(size_t digits) {
+    bench_pause();
+    char *str1 = malloc(2 * digits + 1);
+    char *str2 = malloc(digits + 1);
+    fill_digits(str1, 2 * digits);
+    fill_digits(str2, digits);
+    dynamic_string *quotient = DS_init(NULL);
+    dynamic_string *remainder = DS_init(NULL);
+    bench_resume();
+    divide_strings(quotient, remainder, str1, str2);
+    sink += quotient->length + remainder->length;
+    bench_pause();
+    DS_free(quotient);
+    DS_free(remainder);
+    free(str1);
+    free(str2);
+    bench_resume();
+    return 1;
+}
+
+static size_t bench_sum_strings(size_t digits) {
+    bench_pause();
+    char *str1 = malloc(digits + 1);
+    char *str2 = malloc(digits + 1);
+    fill_digits(str1, digits);
+    fill_digits(str2, digits);
+    dynamic_string *result = DS_init(NULL);
+    bench_resume();
+    sum_strings(result, str1, digits, str2, digits, 0, false);
+    sink += result->length;
+    bench_pause();
+    DS_free(result);
+    free(str1);
+    free(str2);
+    bench_resume();
+    return 1;
+}
+
+static size_t bench_getline(size_t lines) {
+    FILE *file = fopen(bench_file, "r");
+    char *line = NULL;
+    size_t mem_len = 0;
+    size_t count = 0;
+    if (file) {
+        while (count < lines && getline(&line, &mem_len, file) != -1)
+            count++;
+        fclose(file);
+    }
+    free(line);
+    return count;
+}
+
+static size_t bench_list_add_from_file(size_t lines) {
+    list *lst = NULL;
+    list_add_from_file(&lst, bench_file);
+    size_t count = list_get_length(lst);
+    list_free(&lst);
+    return count < lines ? count : lines;
+}
+
+static size_t bench_list_add_from_file_intern(size_t lines) {
+    list *lst = NULL;
+    list_load_options options = {.intern = lw_intern_table_create(NULL)};
+    list_add_from_file_opts(&lst, bench_file, &options);
+    size_t count = list_get_length(lst);
+    list_free(&lst);
+    lw_intern_table_destroy(options.intern);
+    return count < lines ? count : lines;
+}
+
+static size_t bench_lw_intern(size_t count) {
+    static const char *levels[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+    lw_intern_table *table = lw_intern_table_create(NULL);
+    char key[64];
+    for (size_t i = 0; i < count; i++) {
+        int len = snprintf(key, sizeof(key), "%s host-%zu.example.com", levels[i % 4], i % 64);
+        sink += (size_t)lw_intern(table, key, len);
+    }
+    lw_intern_table_destroy(table);
+    return count;
+}
+
+static size_t bench_rand_r(size_t count) {
+    size_t sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += rand_r(&seed);
+    sink += sum;
+    return count;
+}
+
+static size_t bench_get_random_double(size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += get_random_double(&seed, 0, 1000, 1, 6);
+    sink += (size_t)sum;
+    return count;
+}
+
+static bool create_bench_file(void) {
+    static char path[] = "/tmp/lw_utils_bench_XXXXXX";
+    bool ok = false;
+    FILE *file = NULL;
+#if defined(_WIN32)
+    file = fopen(path, "w");
+#else
+    int fd = mkstemp(path);
+    if (fd != -1)
+        file = fdopen(fd, "w");
+#endif
+    if (file) {
+        for (size_t i = 0; i < BENCH_FILE_LINES; i++)
+            fprintf(file, "%zu INFO host-%zu.example.com some repetitive log text %u\n", i, i % 16,
+                    rand_r(&seed));
+        fclose(file);
+        bench_file = path;
+        ok = true;
+    }
+    return ok;
+}
+
+static bench_result run_bench(const char *name, bench_fn fn, size_t param) {
+    bench_result result = {0};
+    snprintf(result.name, BENCH_NAME_LEN, "%s", name);
+    result.param = param;
+    lw_counting_allocator_reset(counter);
+    paused_seconds = 0;
+    paused_allocations = 0;
+    paused_bytes = 0;
+    double start = get_seconds();
+    do {
+        result.ops += fn(param);
+        result.seconds = get_seconds() - start - paused_seconds;
+    } while (result.seconds < min_time);
+    lw_mem_stats stats = lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS);
+    if (result.ops) {
+        result.allocs = (double)(stats.allocations - paused_allocations) / result.ops;
+        result.bytes = (double)(stats.bytes - paused_bytes) / result.ops;
+    }
+    fprintf(stderr, "%-24s %8zu %14.1f ns/op\n", result.name, param, result.seconds * 1e9 / result.ops);
+    return result;
+}
+
+static size_t run_all(bench_result *results) {
+    size_t n = 0;
+    const size_t list_sizes[] = {100, 1000};
+    const size_t digit_counts[] = {10, 100, 1000};
+    for (size_t i = 0; i < sizeof(list_sizes) / sizeof(list_sizes[0]); i++) {
+        results[n++] = run_bench("list_add", bench_list_add, list_sizes[i]);
+        results[n++] = run_bench("list_pop", bench_list_pop, list_sizes[i]);
+        results[n++] = run_bench("list_free", bench_list_free, list_sizes[i]);
+        results[n++] = run_bench("ilist_add_pop", bench_ilist_add_pop, list_sizes[i]);
+    }
+    results[n++] = run_bench("DS_append_char", bench_DS_append_char, 10000);
+    results[n++] = run_bench("DS_insert_text", bench_DS_insert_text, 1000);
+    results[n++] = run_bench("DS_find", bench_DS_find, 1000);
+    results[n++] = run_bench("DS_split", bench_DS_split, 1000);
+    results[n++] = run_bench("DS_replace_all", bench_DS_replace_all, 1000);
+    results[n++] = run_bench("utf8_validate", bench_utf8_validate, 65536);
+    for (size_t i = 0; i < sizeof(digit_counts) / sizeof(digit_counts[0]); i++) {
+        results[n++] = run_bench("multiply_strings", bench_multiply_strings, digit_counts[i]);
+        results[n++] = run_bench("sum_strings", bench_sum_strings, digit_counts[i]);
+        results[n++] = run_bench("divide_strings", bench_divide_strings, digit_counts[i]);
+    }
+    if (create_bench_file()) {
+        results[n++] = run_bench("getline", bench_getline, BENCH_FILE_LINES);
+        results[n++] = run_bench("list_add_from_file", bench_list_add_from_file, BENCH_FILE_LINES);
+        results[n++] = run_bench("list_add_from_file_intern", bench_list_add_from_file_intern,
+                                 BENCH_FILE_LINES);
+        remove(bench_file);
+    } else {
+        fprintf(stderr, "ERROR (bench): couldnt create temporary file, skipping file benchmarks\n");
+    }
+    results[n++] = run_bench("lw_intern", bench_lw_intern, 10000);
+    results[n++] = run_bench("rand_r", bench_rand_r, 100000);
+    results[n++] = run_bench("get_random_double", bench_get_random_double, 100000);
+    return n;
+}
+
+static void print_csv(FILE *out, const bench_result *results, size_t count) {
+    fprintf(out, "name,param,ops,ns_per_op,ops_per_sec,allocs_per_op,bytes_per_op\n");
+    for (size_t i = 0; i < count; i++) {
+        const bench_result *r = &results[i];
+        fprintf(out, "%s,%zu,%zu,%.3f,%.3f,%.3f,%.3f\n", r->name, r->param, r->ops,
+                r->seconds * 1e9 / r->ops, r->ops / r->seconds, r->allocs, r->bytes);
+    }
+}
+
+static void print_json(FILE *out, const bench_result *results, size_t count) {
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < count; i++) {
+        const bench_result *r = &results[i];
+        fprintf(out, "  {\"name\": \"%s\", \"param\": %zu, \"ops\": %zu, \"ns_per_op\": %.3f, "
+                "\"ops_per_sec\": %.3f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.3f}%s\n",
+                r->name, r->param, r->ops, r->seconds * 1e9 / r->ops, r->ops / r->seconds,
+                r->allocs, r->bytes, i + 1 < count ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+// compares ns/op with csv baseline, returns amount of regressions
+static size_t compare_baseline(const char *filename, const bench_result *results, size_t count,
+                               double threshold) {
+    list *lines = NULL;
+    size_t regressions = 0;
+    int error = list_add_from_file(&lines, (char *)filename);
+    if (error) {
+        fprintf(stderr, "ERROR (bench): cant read baseline '%s': %s\n", filename, strerror(error));
+        return 1;
+    }
+    for (list *node = lines; node; node = node->next_node) {
+        char name[BENCH_NAME_LEN];
+        size_t param = 0, ops = 0;
+        double base_ns = 0;
+        if (sscanf(node->data, "%63[^,],%zu,%zu,%lf", name, &param, &ops, &base_ns) != 4)
+            continue;
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(results[i].name, name) == 0 && results[i].param == param) {
+                double ns = results[i].seconds * 1e9 / results[i].ops;
+                double change = (ns - base_ns) / base_ns * 100.0;
+                bool regressed = change > threshold;
+                printf("%-10s %-24s %8zu %14.1f -> %14.1f ns/op (%+.1f%%)\n",
+                       regressed ? "REGRESSION" : "ok", name, param, base_ns, ns, change);
+                regressions += regressed;
+            }
+        }
+    }
+    list_free(&lines);
+    return regressions;
+}
+
+static void print_usage(const char *name) {
+    fprintf(stderr, "usage: %s [--format csv|json] [--output file] [--compare baseline.csv]\n"
+            "          [--threshold percent] [--min-time seconds]\n", name);
+}
+
+int main(int argc, char **argv) {
+    const char *format = "csv";
+    const char *output = NULL;
+    const char *baseline = NULL;
+    double threshold = 10.0;
+    int error = 0;
+    for (int i = 1; i < argc && !error; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            error = EINVAL;
+        }
+    }
+    if (!error && strcmp(format, "csv") != 0 && strcmp(format, "json") != 0) {
+        print_usage(argv[0]);
+        error = EINVAL;
+    }
+    if (!error) {
+        counter = lw_counting_allocator_create(NULL);
+        lw_set_allocator(lw_counting_allocator_get(counter));
+        bench_result results[BENCH_MAX_RESULTS];
+        size_t count = run_all(results);
+        lw_set_allocator(NULL);
+        lw_counting_allocator_destroy(counter);
+        FILE *out = output ? fopen(output, "w") : stdout;
+        if (out) {
+            if (strcmp(format, "json") == 0)
+                print_json(out, results, count);
+            else
+                print_csv(out, results, count);
+            if (out != stdout)
+                fclose(out);
+        } else {
+            fprintf(stderr, "ERROR (bench): cant open '%s': %s\n", output, strerror(errno));
+            error = errno;
+        }
+        if (!error && baseline && compare_baseline(baseline, results, count, threshold))
+            error = 1;
+    }
+    return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
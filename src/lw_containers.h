@@ -0,0 +1,413 @@
+// Copyright 2021 <lwolmer>
+/// @file
+/// @brief Type specialized containers generated by macros, elements are stored inline without void* boxing
+#ifndef SRC_LW_CONTAINERS_H_
+#define SRC_LW_CONTAINERS_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "lw_utils.h"
+
+/// @brief Allocator of the container, NULL means global one
+#define LW_CONTAINER_ALLOCATOR(allocator) ((allocator) ? (allocator) : lw_get_allocator())
+
+/// @brief Hash for integer keys (splitmix64 finalizer)
+static inline size_t lw_hash_u64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (size_t)x;
+}
+
+/// @brief Hash for int keys
+static inline size_t lw_hash_int(int x) {
+    return lw_hash_u64((uint64_t)(unsigned int)x);
+}
+
+/// @brief Hash for zero terminated strings (FNV-1a)
+static inline size_t lw_hash_str(const char *str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (*str)
+        hash = (hash ^ (unsigned char)*str++) * 0x100000001b3ULL;
+    return (size_t)hash;
+}
+
+/// @brief Equality for int keys
+static inline bool lw_eq_int(int a, int b) {
+    return a == b;
+}
+
+/// @brief Equality for zero terminated string keys
+static inline bool lw_eq_str(const char *a, const char *b) {
+    return strcmp(a, b) == 0;
+}
+
+/**
+    @brief Defines dynamic array `name` of `type` elements and its functions:
+    name_init, name_reserve, name_push, name_pop, name_at, name_clear, name_free,
+    name_from_list, name_to_list
+*/
+#define LW_DEFINE_VECTOR(name, type)                                                                   \
+typedef struct {                                                                                       \
+    type *data;  /**< elements*/                                                                       \
+    size_t length;  /**< amount of elements*/                                                          \
+    size_t capacity;  /**< amount of elements that fit without reallocation*/                          \
+    const lw_allocator *allocator;  /**< allocator of data*/                                           \
+} name;                                                                                                \
+                                                                                                       \
+static inline void name##_init(name *vec, const lw_allocator *allocator) {                             \
+    vec->data = NULL;                                                                                  \
+    vec->length = 0;                                                                                   \
+    vec->capacity = 0;                                                                                 \
+    vec->allocator = LW_CONTAINER_ALLOCATOR(allocator);                                                \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_reserve(name *vec, size_t capacity) {                                        \
+    if (capacity <= vec->capacity)                                                                     \
+        return true;                                                                                   \
+    type *data = vec->allocator->realloc(vec->allocator->context, vec->data,                           \
+                                         capacity * sizeof(type), LW_MEM_OTHER);                       \
+    if (data == NULL)                                                                                  \
+        return false;                                                                                  \
+    vec->data = data;                                                                                  \
+    vec->capacity = capacity;                                                                          \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_push(name *vec, type value) {                                                \
+    if (vec->length == vec->capacity &&                                                                \
+        !name##_reserve(vec, vec->capacity ? vec->capacity * 2 : 8))                                   \
+        return false;                                                                                  \
+    vec->data[vec->length++] = value;                                                                  \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_pop(name *vec, type *value) {                                                \
+    if (vec->length == 0)                                                                              \
+        return false;                                                                                  \
+    vec->length--;                                                                                     \
+    if (value)                                                                                         \
+        *value = vec->data[vec->length];                                                               \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline type *name##_at(const name *vec, size_t index) {                                         \
+    return index < vec->length ? &vec->data[index] : NULL;                                             \
+}                                                                                                      \
+                                                                                                       \
+static inline void name##_clear(name *vec) {                                                           \
+    vec->length = 0;                                                                                   \
+}                                                                                                      \
+                                                                                                       \
+static inline void name##_free(name *vec) {                                                            \
+    if (vec->data)                                                                                     \
+        vec->allocator->free(vec->allocator->context, vec->data);                                      \
+    vec->data = NULL;                                                                                  \
+    vec->length = 0;                                                                                   \
+    vec->capacity = 0;                                                                                 \
+}                                                                                                      \
+                                                                                                       \
+/* appends copies of elements that list data points to */                                              \
+static inline bool name##_from_list(name *vec, const list *first_node) {                               \
+    bool ok = name##_reserve(vec, vec->length + list_get_length(first_node));                          \
+    for (const list *node = first_node; ok && node; node = node->next_node)                            \
+        vec->data[vec->length++] = *(const type *)node->data;                                          \
+    return ok;                                                                                         \
+}                                                                                                      \
+                                                                                                       \
+/* appends dynamic copies of elements to list, list_free frees them with vec->allocator */             \
+static inline list *name##_to_list(const name *vec, list **first_node) {                               \
+    list *last = list_get_last(*first_node);                                                           \
+    for (size_t i = 0; i < vec->length; i++) {                                                         \
+        type *data = vec->allocator->alloc(vec->allocator->context, sizeof(type), LW_MEM_LIST);        \
+        if (data) {                                                                                    \
+            *data = vec->data[i];                                                                      \
+            list_add_alloc(last ? &last : first_node, data, true, vec->allocator);                     \
+            last = last ? last->next_node : *first_node;                                               \
+        }                                                                                              \
+    }                                                                                                  \
+    return *first_node;                                                                                \
+}
+
+/**
+    @brief Defines name_sort for vector `name` of `type`, `less` is function or macro (a, b) -> bool
+    that is inlined into the sort
+*/
+#define LW_DEFINE_VECTOR_SORT(name, type, less)                                                        \
+static inline void name##_sort_range(type *data, size_t count) {                                       \
+    while (count > 16) {                                                                               \
+        type pivot = data[count / 2];                                                                  \
+        size_t i = 0, j = count - 1;                                                                   \
+        while (true) {                                                                                 \
+            while (less(data[i], pivot))                                                               \
+                i++;                                                                                   \
+            while (less(pivot, data[j]))                                                               \
+                j--;                                                                                   \
+            if (i >= j)                                                                                \
+                break;                                                                                 \
+            type t = data[i];                                                                          \
+            data[i++] = data[j];                                                                       \
+            data[j--] = t;                                                                             \
+        }                                                                                              \
+        /* recursing into smaller part keeps stack depth logarithmic */                                \
+        if (j + 1 < count - j - 1) {                                                                   \
+            name##_sort_range(data, j + 1);                                                            \
+            data += j + 1;                                                                             \
+            count -= j + 1;                                                                            \
+        } else {                                                                                       \
+            name##_sort_range(data + j + 1, count - j - 1);                                            \
+            count = j + 1;                                                                             \
+        }                                                                                              \
+    }                                                                                                  \
+    for (size_t i = 1; i < count; i++) {                                                               \
+        type t = data[i];                                                                              \
+        size_t j = i;                                                                                  \
+        for (; j > 0 && less(t, data[j - 1]); j--)                                                     \
+            data[j] = data[j - 1];                                                                     \
+        data[j] = t;                                                                                   \
+    }                                                                                                  \
+}                                                                                                      \
+                                                                                                       \
+static inline void name##_sort(name *vec) {                                                            \
+    name##_sort_range(vec->data, vec->length);                                                         \
+}
+
+/**
+    @brief Defines singly linked list `name` of `type` elements stored inside nodes and its functions:
+    name_init, name_push_back, name_push_front, name_pop_front, name_free, name_from_list, name_to_list
+*/
+#define LW_DEFINE_LIST(name, type)                                                                     \
+typedef struct name##_node {                                                                           \
+    type value;                                                                                        \
+    struct name##_node *next;                                                                          \
+} name##_node;                                                                                         \
+                                                                                                       \
+typedef struct {                                                                                       \
+    name##_node *head;  /**< first node*/                                                              \
+    name##_node *tail;  /**< last node*/                                                               \
+    size_t length;  /**< amount of elements*/                                                          \
+    const lw_allocator *allocator;  /**< allocator of nodes*/                                          \
+} name;                                                                                                \
+                                                                                                       \
+static inline void name##_init(name *lst, const lw_allocator *allocator) {                             \
+    lst->head = NULL;                                                                                  \
+    lst->tail = NULL;                                                                                  \
+    lst->length = 0;                                                                                   \
+    lst->allocator = LW_CONTAINER_ALLOCATOR(allocator);                                                \
+}                                                                                                      \
+                                                                                                       \
+static inline name##_node *name##_new_node(name *lst, type value) {                                    \
+    name##_node *node = lst->allocator->alloc(lst->allocator->context, sizeof(name##_node),            \
+                                              LW_MEM_LIST);                                            \
+    if (node) {                                                                                        \
+        node->value = value;                                                                           \
+        node->next = NULL;                                                                             \
+        lst->length++;                                                                                 \
+    }                                                                                                  \
+    return node;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_push_back(name *lst, type value) {                                           \
+    name##_node *node = name##_new_node(lst, value);                                                   \
+    if (node) {                                                                                        \
+        if (lst->tail)                                                                                 \
+            lst->tail->next = node;                                                                    \
+        else                                                                                           \
+            lst->head = node;                                                                          \
+        lst->tail = node;                                                                              \
+    }                                                                                                  \
+    return node != NULL;                                                                               \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_push_front(name *lst, type value) {                                          \
+    name##_node *node = name##_new_node(lst, value);                                                   \
+    if (node) {                                                                                        \
+        node->next = lst->head;                                                                        \
+        lst->head = node;                                                                              \
+        if (lst->tail == NULL)                                                                         \
+            lst->tail = node;                                                                          \
+    }                                                                                                  \
+    return node != NULL;                                                                               \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_pop_front(name *lst, type *value) {                                          \
+    name##_node *node = lst->head;                                                                     \
+    if (node == NULL)                                                                                  \
+        return false;                                                                                  \
+    if (value)                                                                                         \
+        *value = node->value;                                                                          \
+    lst->head = node->next;                                                                            \
+    if (lst->head == NULL)                                                                             \
+        lst->tail = NULL;                                                                              \
+    lst->length--;                                                                                     \
+    lst->allocator->free(lst->allocator->context, node);                                               \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline void name##_free(name *lst) {                                                            \
+    while (name##_pop_front(lst, NULL)) {}                                                             \
+}                                                                                                      \
+                                                                                                       \
+/* appends copies of elements that list data points to */                                              \
+static inline bool name##_from_list(name *lst, const list *first_node) {                               \
+    bool ok = true;                                                                                    \
+    for (const list *node = first_node; ok && node; node = node->next_node)                            \
+        ok = name##_push_back(lst, *(const type *)node->data);                                         \
+    return ok;                                                                                         \
+}                                                                                                      \
+                                                                                                       \
+/* appends dynamic copies of elements to list, list_free frees them with lst->allocator */             \
+static inline list *name##_to_list(const name *lst, list **first_node) {                               \
+    list *last = list_get_last(*first_node);                                                           \
+    for (const name##_node *node = lst->head; node; node = node->next) {                               \
+        type *data = lst->allocator->alloc(lst->allocator->context, sizeof(type), LW_MEM_LIST);        \
+        if (data) {                                                                                    \
+            *data = node->value;                                                                       \
+            list_add_alloc(last ? &last : first_node, data, true, lst->allocator);                     \
+            last = last ? last->next_node : *first_node;                                               \
+        }                                                                                              \
+    }                                                                                                  \
+    return *first_node;                                                                                \
+}
+
+/**
+    @brief Defines open addressing hash map `name` from `key_type` to `value_type` and its functions:
+    name_init, name_put, name_get, name_remove, name_free, name_from_list, name_to_list (list elements
+    are name_pair). `hash` (key) -> size_t and `equal` (a, b) -> bool are functions or macros that are
+    inlined into lookups
+*/
+#define LW_DEFINE_MAP(name, key_type, value_type, hash, equal)                                         \
+typedef struct {                                                                                       \
+    key_type key;                                                                                      \
+    value_type value;                                                                                  \
+    bool used;                                                                                         \
+} name##_entry;                                                                                        \
+                                                                                                       \
+/* key and value that map exchanges with list */                                                       \
+typedef struct {                                                                                       \
+    key_type key;                                                                                      \
+    value_type value;                                                                                  \
+} name##_pair;                                                                                         \
+                                                                                                       \
+typedef struct {                                                                                       \
+    name##_entry *entries;  /**< slots, amount is power of two*/                                       \
+    size_t capacity;  /**< amount of slots*/                                                           \
+    size_t length;  /**< amount of used slots*/                                                        \
+    const lw_allocator *allocator;  /**< allocator of slots*/                                          \
+} name;                                                                                                \
+                                                                                                       \
+static inline void name##_init(name *map, const lw_allocator *allocator) {                             \
+    map->entries = NULL;                                                                               \
+    map->capacity = 0;                                                                                 \
+    map->length = 0;                                                                                   \
+    map->allocator = LW_CONTAINER_ALLOCATOR(allocator);                                                \
+}                                                                                                      \
+                                                                                                       \
+static inline name##_entry *name##_find_slot(const name##_entry *entries, size_t capacity,             \
+                                             key_type key) {                                           \
+    size_t mask = capacity - 1;                                                                        \
+    size_t i = hash(key) & mask;                                                                       \
+    while (entries[i].used && !equal(entries[i].key, key))                                             \
+        i = (i + 1) & mask;                                                                            \
+    return (name##_entry *)&entries[i];                                                                \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_grow(name *map) {                                                            \
+    size_t capacity = map->capacity ? map->capacity * 2 : 16;                                          \
+    name##_entry *entries = map->allocator->alloc(map->allocator->context,                             \
+                                                  capacity * sizeof(name##_entry), LW_MEM_OTHER);      \
+    if (entries == NULL)                                                                               \
+        return false;                                                                                  \
+    for (size_t i = 0; i < capacity; i++)                                                              \
+        entries[i].used = false;                                                                       \
+    for (size_t i = 0; i < map->capacity; i++)                                                         \
+        if (map->entries[i].used)                                                                      \
+            *name##_find_slot(entries, capacity, map->entries[i].key) = map->entries[i];               \
+    if (map->entries)                                                                                  \
+        map->allocator->free(map->allocator->context, map->entries);                                   \
+    map->entries = entries;                                                                            \
+    map->capacity = capacity;                                                                          \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline value_type *name##_get(const name *map, key_type key) {                                  \
+    if (map->length == 0)                                                                              \
+        return NULL;                                                                                   \
+    name##_entry *entry = name##_find_slot(map->entries, map->capacity, key);                          \
+    return entry->used ? &entry->value : NULL;                                                         \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_put(name *map, key_type key, value_type value) {                             \
+    /* keeping load factor under 3/4 */                                                                \
+    if ((map->length + 1) * 4 > map->capacity * 3 && !name##_grow(map))                                \
+        return false;                                                                                  \
+    name##_entry *entry = name##_find_slot(map->entries, map->capacity, key);                          \
+    if (!entry->used) {                                                                                \
+        entry->used = true;                                                                            \
+        entry->key = key;                                                                              \
+        map->length++;                                                                                 \
+    }                                                                                                  \
+    entry->value = value;                                                                              \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline bool name##_remove(name *map, key_type key) {                                            \
+    name##_entry *entry = map->length ? name##_find_slot(map->entries, map->capacity, key) : NULL;     \
+    if (entry == NULL || !entry->used)                                                                 \
+        return false;                                                                                  \
+    size_t mask = map->capacity - 1;                                                                   \
+    /* backward shift deletion: moving following entries of the probe chain into the hole */           \
+    size_t hole = entry - map->entries;                                                                \
+    size_t i = (hole + 1) & mask;                                                                      \
+    while (map->entries[i].used) {                                                                     \
+        size_t home = hash(map->entries[i].key) & mask;                                                \
+        if (((i - home) & mask) >= ((i - hole) & mask)) {                                              \
+            map->entries[hole] = map->entries[i];                                                      \
+            hole = i;                                                                                  \
+        }                                                                                              \
+        i = (i + 1) & mask;                                                                            \
+    }                                                                                                  \
+    map->entries[hole].used = false;                                                                   \
+    map->length--;                                                                                     \
+    return true;                                                                                       \
+}                                                                                                      \
+                                                                                                       \
+static inline void name##_free(name *map) {                                                            \
+    if (map->entries)                                                                                  \
+        map->allocator->free(map->allocator->context, map->entries);                                   \
+    map->entries = NULL;                                                                               \
+    map->capacity = 0;                                                                                 \
+    map->length = 0;                                                                                   \
+}                                                                                                      \
+                                                                                                       \
+/* puts pairs that list data points to, later ones replace values of equal keys */                     \
+static inline bool name##_from_list(name *map, const list *first_node) {                               \
+    bool ok = true;                                                                                    \
+    for (const list *node = first_node; ok && node; node = node->next_node) {                          \
+        const name##_pair *pair = node->data;                                                          \
+        ok = name##_put(map, pair->key, pair->value);                                                  \
+    }                                                                                                  \
+    return ok;                                                                                         \
+}                                                                                                      \
+                                                                                                       \
+/* appends dynamic copies of pairs to list in slot order, list_free frees them with map->allocator */  \
+static inline list *name##_to_list(const name *map, list **first_node) {                               \
+    list *last = list_get_last(*first_node);                                                           \
+    for (size_t i = 0; i < map->capacity; i++) {                                                       \
+        if (!map->entries[i].used)                                                                     \
+            continue;                                                                                  \
+        name##_pair *data = map->allocator->alloc(map->allocator->context, sizeof(name##_pair),        \
+                                                  LW_MEM_LIST);                                        \
+        if (data) {                                                                                    \
+            data->key = map->entries[i].key;                                                           \
+            data->value = map->entries[i].value;                                                       \
+            list_add_alloc(last ? &last : first_node, data, true, map->allocator);                     \
+            last = last ? last->next_node : *first_node;                                               \
+        }                                                                                              \
+    }                                                                                                  \
+    return *first_node;                                                                                \
+}
+
+#endif  // SRC_LW_CONTAINERS_H_
@@ -4,6 +4,25 @@
 #include <errno.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// vector kernels for newer extensions are compiled with target attributes and chosen at runtime
+#define LW_X86_DISPATCH
+#include <immintrin.h>
+#endif
+#include <limits.h>
 #include "lw_utils.h"
 
 
@@ -73,45 +92,398 @@ int rand_r(unsigned int *seed) {
 }
 #endif
 
-list *new_node(void *data, bool is_dynamic) {
-    list *new_node = malloc(sizeof(list));
+static void *default_alloc(void *context, size_t size, lw_mem_subsystem subsystem) {
+    (void)context;
+    (void)subsystem;
+    return malloc(size);
+}
+
+static void *default_realloc(void *context, void *ptr, size_t size, lw_mem_subsystem subsystem) {
+    (void)context;
+    (void)subsystem;
+    return realloc(ptr, size);
+}
+
+static void default_free(void *context, void *ptr) {
+    (void)context;
+    free(ptr);
+}
+
+static const lw_allocator default_allocator = {default_alloc, default_realloc, default_free, NULL};
+static const lw_allocator *global_allocator = &default_allocator;
+
+const lw_allocator *lw_get_allocator(void) {
+    return global_allocator;
+}
+
+void lw_set_allocator(const lw_allocator *allocator) {
+    global_allocator = allocator ? allocator : &default_allocator;
+}
+
+static inline void *lw_alloc(const lw_allocator *allocator, size_t size, lw_mem_subsystem subsystem) {
+    return allocator->alloc(allocator->context, size, subsystem);
+}
+
+static inline void *lw_realloc(const lw_allocator *allocator, void *ptr, size_t size,
+                               lw_mem_subsystem subsystem) {
+    return allocator->realloc(allocator->context, ptr, size, subsystem);
+}
+
+static inline void lw_free(const lw_allocator *allocator, void *ptr) {
+    if (ptr)
+        allocator->free(allocator->context, ptr);
+}
+
+// header in front of every block of counting allocator, keeps size for statistics on free
+typedef union {
+    struct {
+        size_t size;
+        lw_mem_subsystem subsystem;
+    } info;
+    max_align_t align;
+} counting_header;
+
+struct lw_counting_allocator {
+    lw_allocator allocator;
+    const lw_allocator *parent;
+    pthread_mutex_t lock;
+    lw_mem_stats stats[LW_MEM_SUBSYSTEMS];
+};
+
+static void counting_add(lw_counting_allocator *counter, lw_mem_subsystem subsystem, size_t size) {
+    lw_mem_stats *stats = &counter->stats[subsystem];
+    stats->allocations++;
+    stats->bytes += size;
+    stats->current += size;
+    stats->peak = max_size(stats->peak, stats->current);
+}
+
+static void *counting_alloc(void *context, size_t size, lw_mem_subsystem subsystem) {
+    lw_counting_allocator *counter = context;
+    counting_header *header = lw_alloc(counter->parent, sizeof(counting_header) + size, subsystem);
+    if (header) {
+        header->info.size = size;
+        header->info.subsystem = subsystem;
+        pthread_mutex_lock(&counter->lock);
+        counting_add(counter, subsystem, size);
+        pthread_mutex_unlock(&counter->lock);
+        header++;
+    }
+    return header;
+}
+
+static void counting_free(void *context, void *ptr) {
+    lw_counting_allocator *counter = context;
+    counting_header *header = (counting_header *)ptr - 1;
+    pthread_mutex_lock(&counter->lock);
+    counter->stats[header->info.subsystem].frees++;
+    counter->stats[header->info.subsystem].current -= header->info.size;
+    pthread_mutex_unlock(&counter->lock);
+    lw_free(counter->parent, header);
+}
+
+static void *counting_realloc(void *context, void *ptr, size_t size, lw_mem_subsystem subsystem) {
+    lw_counting_allocator *counter = context;
+    if (ptr == NULL)
+        return counting_alloc(context, size, subsystem);
+    counting_header *header = (counting_header *)ptr - 1;
+    size_t old_size = header->info.size;
+    lw_mem_subsystem old_subsystem = header->info.subsystem;
+    header = lw_realloc(counter->parent, header, sizeof(counting_header) + size, subsystem);
+    if (header) {
+        header->info.size = size;
+        header->info.subsystem = subsystem;
+        pthread_mutex_lock(&counter->lock);
+        counter->stats[old_subsystem].current -= old_size;
+        counting_add(counter, subsystem, size);
+        pthread_mutex_unlock(&counter->lock);
+        header++;
+    }
+    return header;
+}
+
+lw_counting_allocator *lw_counting_allocator_create(const lw_allocator *parent) {
+    if (parent == NULL)
+        parent = &default_allocator;
+    lw_counting_allocator *counter = lw_alloc(parent, sizeof(lw_counting_allocator), LW_MEM_OTHER);
+    if (counter) {
+        memset(counter, 0, sizeof(lw_counting_allocator));
+        counter->allocator.alloc = counting_alloc;
+        counter->allocator.realloc = counting_realloc;
+        counter->allocator.free = counting_free;
+        counter->allocator.context = counter;
+        counter->parent = parent;
+        pthread_mutex_init(&counter->lock, NULL);
+    }
+    return counter;
+}
+
+const lw_allocator *lw_counting_allocator_get(lw_counting_allocator *counter) {
+    return counter ? &counter->allocator : NULL;
+}
+
+lw_mem_stats lw_counting_allocator_stats(lw_counting_allocator *counter, lw_mem_subsystem subsystem) {
+    lw_mem_stats stats = {0};
+    if (counter) {
+        pthread_mutex_lock(&counter->lock);
+        if (subsystem < LW_MEM_SUBSYSTEMS) {
+            stats = counter->stats[subsystem];
+        } else {
+            for (int i = 0; i < LW_MEM_SUBSYSTEMS; i++) {
+                stats.allocations += counter->stats[i].allocations;
+                stats.frees += counter->stats[i].frees;
+                stats.bytes += counter->stats[i].bytes;
+                stats.current += counter->stats[i].current;
+                // peaks of subsystems may happen at different time, so this is upper bound
+                stats.peak += counter->stats[i].peak;
+            }
+        }
+        pthread_mutex_unlock(&counter->lock);
+    }
+    return stats;
+}
+
+void lw_counting_allocator_reset(lw_counting_allocator *counter) {
+    if (counter) {
+        pthread_mutex_lock(&counter->lock);
+        for (int i = 0; i < LW_MEM_SUBSYSTEMS; i++) {
+            size_t current = counter->stats[i].current;
+            memset(&counter->stats[i], 0, sizeof(lw_mem_stats));
+            counter->stats[i].current = current;
+            counter->stats[i].peak = current;
+        }
+        pthread_mutex_unlock(&counter->lock);
+    }
+}
+
+void lw_counting_allocator_destroy(lw_counting_allocator *counter) {
+    if (counter) {
+        pthread_mutex_destroy(&counter->lock);
+        lw_free(counter->parent, counter);
+    }
+}
+
+// arena chunks are at least this big, longer strings get chunk of their own size
+#define INTERN_CHUNK_SIZE 65536
+#define INTERN_MIN_SLOTS 64
+
+// chunk of append only arena, strings never move so pointers to them stay valid
+typedef struct intern_chunk {
+    struct intern_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} intern_chunk;
+
+typedef struct {
+    size_t hash;
+    size_t length;
+    const char *string;  // NULL for empty slot
+} intern_slot;
+
+struct lw_intern_table {
+    const lw_allocator *allocator;
+    intern_chunk *chunks;  // newest chunk first
+    intern_slot *slots;  // open addressing with linear probing
+    size_t slot_count;  // power of two
+    lw_intern_stats stats;
+};
+
+// hashes 8 bytes at the time and mixes them with multiply-xorshift
+static size_t intern_hash(const char *str, size_t len) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ len;
+    uint64_t block;
+    for (; len >= sizeof(block); len -= sizeof(block), str += sizeof(block)) {
+        memcpy(&block, str, sizeof(block));
+        hash = (hash ^ block) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+    block = 0;
+    memcpy(&block, str, len);
+    hash = (hash ^ block) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 29;
+    return (size_t)hash;
+}
+
+lw_intern_table *lw_intern_table_create(const lw_allocator *allocator) {
+    if (allocator == NULL)
+        allocator = global_allocator;
+    lw_intern_table *table = lw_alloc(allocator, sizeof(lw_intern_table), LW_MEM_STRING);
+    if (table) {
+        memset(table, 0, sizeof(lw_intern_table));
+        table->allocator = allocator;
+        table->slot_count = INTERN_MIN_SLOTS;
+        table->slots = lw_alloc(allocator, table->slot_count * sizeof(intern_slot), LW_MEM_STRING);
+        if (table->slots == NULL) {
+            fprintf(stderr, "ERROR (intern): Couldnt malloc.\n");
+            lw_free(allocator, table);
+            return NULL;
+        }
+        memset(table->slots, 0, table->slot_count * sizeof(intern_slot));
+    }
+    return table;
+}
+
+// doubles amount of slots, stored hashes are reused
+static bool intern_grow(lw_intern_table *table) {
+    size_t slot_count = table->slot_count * 2;
+    intern_slot *slots = lw_alloc(table->allocator, slot_count * sizeof(intern_slot), LW_MEM_STRING);
+    if (slots == NULL)
+        return false;
+    memset(slots, 0, slot_count * sizeof(intern_slot));
+    for (size_t i = 0; i < table->slot_count; i++) {
+        if (table->slots[i].string) {
+            size_t j = table->slots[i].hash & (slot_count - 1);
+            while (slots[j].string)
+                j = (j + 1) & (slot_count - 1);
+            slots[j] = table->slots[i];
+        }
+    }
+    lw_free(table->allocator, table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    return true;
+}
+
+// copies string into the arena
+static const char *intern_store(lw_intern_table *table, const char *str, size_t len) {
+    intern_chunk *chunk = table->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < len + 1) {
+        size_t size = max_size(INTERN_CHUNK_SIZE, len + 1);
+        chunk = lw_alloc(table->allocator, sizeof(intern_chunk) + size, LW_MEM_STRING);
+        if (chunk == NULL)
+            return NULL;
+        chunk->used = 0;
+        chunk->size = size;
+        chunk->next = table->chunks;
+        table->chunks = chunk;
+    }
+    char *string = chunk->data + chunk->used;
+    memcpy(string, str, len);
+    string[len] = 0;
+    chunk->used += len + 1;
+    table->stats.bytes += len + 1;
+    return string;
+}
+
+const char *lw_intern(lw_intern_table *table, const char *str, size_t len) {
+    if (table == NULL || str == NULL)
+        return NULL;
+    // keeping load factor at most 3/4 so probe sequences stay short
+    if ((table->stats.unique + 1) * 4 > table->slot_count * 3 && !intern_grow(table)) {
+        fprintf(stderr, "ERROR (intern): Couldnt malloc.\n");
+        return NULL;
+    }
+    const size_t hash = intern_hash(str, len);
+    size_t i = hash & (table->slot_count - 1);
+    while (table->slots[i].string) {
+        intern_slot *slot = &table->slots[i];
+        if (slot->hash == hash && slot->length == len && memcmp(slot->string, str, len) == 0) {
+            table->stats.total++;
+            table->stats.bytes_saved += len + 1;
+            return slot->string;
+        }
+        i = (i + 1) & (table->slot_count - 1);
+    }
+    const char *string = intern_store(table, str, len);
+    if (string == NULL) {
+        fprintf(stderr, "ERROR (intern): Couldnt malloc.\n");
+        return NULL;
+    }
+    table->slots[i] = (intern_slot){hash, len, string};
+    table->stats.unique++;
+    table->stats.total++;
+    return string;
+}
+
+lw_intern_stats lw_intern_table_stats(const lw_intern_table *table) {
+    lw_intern_stats stats = {0};
+    if (table) {
+        stats = table->stats;
+        stats.dedup_ratio = stats.unique ? (double)stats.total / stats.unique : 1.0;
+    }
+    return stats;
+}
+
+void lw_intern_table_destroy(lw_intern_table *table) {
+    if (table) {
+        while (table->chunks) {
+            intern_chunk *next = table->chunks->next;
+            lw_free(table->allocator, table->chunks);
+            table->chunks = next;
+        }
+        lw_free(table->allocator, table->slots);
+        lw_free(table->allocator, table);
+    }
+}
+
+list *new_node(void *data, bool is_dynamic, const lw_allocator *allocator,
+               const lw_allocator *data_allocator) {
+    list *new_node = lw_alloc(allocator, sizeof(list), LW_MEM_LIST);
     if (new_node) {
         new_node->data = data;
         new_node->is_dynamic = is_dynamic;
         new_node->next_node = NULL;
+        new_node->allocator = allocator;
+        new_node->data_allocator = data_allocator;
     }
     return new_node;
 }
 
-list *list_add(list **first_node, void *data, bool is_dynamic) {
+static list *add_node(list **first_node, void *data, bool is_dynamic, const lw_allocator *allocator,
+                      const lw_allocator *data_allocator) {
     if (first_node && *first_node) {
         list *node_head = *first_node;
         while (node_head->next_node)
             node_head = node_head->next_node;
-        node_head->next_node = new_node(data, is_dynamic);
+        node_head->next_node = new_node(data, is_dynamic, allocator, data_allocator);
     } else if (first_node) {
-        *first_node = new_node(data, is_dynamic);
+        *first_node = new_node(data, is_dynamic, allocator, data_allocator);
     }
     return first_node ? *first_node : NULL;
 }
 
+list *list_add_alloc(list **first_node, void *data, bool is_dynamic, const lw_allocator *allocator) {
+    return add_node(first_node, data, is_dynamic, allocator, allocator);
+}
 
+list *list_add(list **first_node, void *data, bool is_dynamic) {
+    // caller allocates data with malloc, so only node comes from global allocator
+    return add_node(first_node, data, is_dynamic, global_allocator, &default_allocator);
+}
 
-int list_add_from_file(list **first_node, char *filename) {
+int list_add_from_file_opts(list **first_node, char *filename, list_load_options *options) {
+    const lw_allocator *allocator = options && options->allocator ? options->allocator : global_allocator;
     FILE *file = fopen(filename, "r");
     int error = 0;
+    if (options)
+        options->error_line = 0;
     if (file) {
         ssize_t read = 0;
         size_t mem_len = 0;
+        size_t line_number = 0;
         char *line = NULL;
         while ((read = getline(&line, &mem_len, file)) != -1) {
             size_t eol = strcspn(line, "\n");
-            if (eol)
-                line[eol] = 0;
-            char *data = calloc(1, eol + 1);
+            line_number++;
+            // validating line while it is still in cache after reading
+            if (options && options->validate_utf8 && !utf8_validate(line, eol)) {
+                options->error_line = line_number;
+                error = EILSEQ;
+                break;
+            }
+            if (options && options->intern) {
+                // node points into the table, so it doesnt own its line
+                const char *data = lw_intern(options->intern, line, eol);
+                if (data)
+                    list_add_alloc(first_node, (void *)data, false, allocator);
+                continue;
+            }
+            char *data = lw_alloc(allocator, eol + 1, LW_MEM_LIST);
             if (data) {
-                strncpy(data, line, eol);
-                list_add(first_node, ((void*)data), true);
+                memcpy(data, line, eol);
+                data[eol] = 0;
+                list_add_alloc(first_node, ((void*)data), true, allocator);
             }
         }
         if (line)
@@ -123,10 +495,19 @@ int list_add_from_file(list **first_node, char *filename) {
     return error;
 }
 
+int list_add_from_file_alloc(list **first_node, char *filename, const lw_allocator *allocator) {
+    list_load_options options = {.allocator = allocator};
+    return list_add_from_file_opts(first_node, filename, &options);
+}
+
+int list_add_from_file(list **first_node, char *filename) {
+    return list_add_from_file_alloc(first_node, filename, global_allocator);
+}
+
 void free_node(list **node) {
     if ((*node)->is_dynamic)
-        free((*node)->data);
-    free(*node);
+        lw_free((*node)->data_allocator, (*node)->data);
+    lw_free((*node)->allocator, *node);
 }
 
 void list_pop(list **first_node) {
@@ -171,6 +552,286 @@ size_t list_get_length(const list *first_node) {
     return len;
 }
 
+// external definitions of inline helpers, so the library keeps exporting them
+extern inline long max_long(long a, long b);
+extern inline long min_long(long a, long b);
+extern inline long clamp_long(long d, long min, long max);
+extern inline size_t max_size(size_t a, size_t b);
+extern inline size_t min_size(size_t a, size_t b);
+extern inline ilist_link *ilist_get_last(const ilist *lst);
+extern inline size_t ilist_get_length(const ilist *lst);
+
+void ilist_init(ilist *lst) {
+    lst->head = NULL;
+    lst->tail = NULL;
+    lst->length = 0;
+}
+
+void ilist_add(ilist *lst, ilist_link *link) {
+    link->next = NULL;
+    link->prev = lst->tail;
+    if (lst->tail)
+        lst->tail->next = link;
+    else
+        lst->head = link;
+    lst->tail = link;
+    lst->length++;
+}
+
+void ilist_add_front(ilist *lst, ilist_link *link) {
+    link->prev = NULL;
+    link->next = lst->head;
+    if (lst->head)
+        lst->head->prev = link;
+    else
+        lst->tail = link;
+    lst->head = link;
+    lst->length++;
+}
+
+void ilist_remove(ilist *lst, ilist_link *link) {
+    if (link->prev)
+        link->prev->next = link->next;
+    else
+        lst->head = link->next;
+    if (link->next)
+        link->next->prev = link->prev;
+    else
+        lst->tail = link->prev;
+    link->prev = NULL;
+    link->next = NULL;
+    lst->length--;
+}
+
+ilist_link *ilist_pop(ilist *lst) {
+    ilist_link *link = lst->tail;
+    if (link)
+        ilist_remove(lst, link);
+    return link;
+}
+
+ilist_link *ilist_pop_front(ilist *lst) {
+    ilist_link *link = lst->head;
+    if (link)
+        ilist_remove(lst, link);
+    return link;
+}
+
+// padding between atomics that are written by different threads
+#define CACHE_LINE_SIZE 64
+
+typedef struct {
+    _Atomic size_t sequence;
+    list item;
+} lfqueue_cell;
+
+struct lfqueue {
+    lfqueue_cell *cells;
+    size_t mask;
+    const lw_allocator *allocator;
+    char pad1[CACHE_LINE_SIZE];
+    _Atomic size_t enqueue_pos;
+    char pad2[CACHE_LINE_SIZE];
+    _Atomic size_t dequeue_pos;
+    char pad3[CACHE_LINE_SIZE];
+};
+
+lfqueue *lfqueue_create(size_t capacity, const lw_allocator *allocator) {
+    if (allocator == NULL)
+        allocator = global_allocator;
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    lfqueue *queue = lw_alloc(allocator, sizeof(lfqueue), LW_MEM_LIST);
+    if (queue) {
+        queue->cells = lw_alloc(allocator, size * sizeof(lfqueue_cell), LW_MEM_LIST);
+        if (queue->cells == NULL) {
+            fprintf(stderr, "ERROR (lfqueue): error during malloc\n");
+            lw_free(allocator, queue);
+            return NULL;
+        }
+        queue->mask = size - 1;
+        queue->allocator = allocator;
+        for (size_t i = 0; i < size; i++)
+            atomic_init(&queue->cells[i].sequence, i);
+        atomic_init(&queue->enqueue_pos, 0);
+        atomic_init(&queue->dequeue_pos, 0);
+    }
+    return queue;
+}
+
+bool lfqueue_push(lfqueue *queue, void *data, bool is_dynamic) {
+    lfqueue_cell *cell = NULL;
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    while (cell == NULL) {
+        lfqueue_cell *candidate = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&candidate->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            // cell is free for this position, trying to claim it
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                cell = candidate;
+        } else if (diff < 0) {
+            // cell still holds item from previous lap, queue is full
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    cell->item.data = data;
+    cell->item.is_dynamic = is_dynamic;
+    cell->item.next_node = NULL;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+bool lfqueue_pop(lfqueue *queue, void **data, bool *is_dynamic) {
+    lfqueue_cell *cell = NULL;
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    while (cell == NULL) {
+        lfqueue_cell *candidate = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&candidate->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                cell = candidate;
+        } else if (diff < 0) {
+            // nothing was pushed to this position yet, queue is empty
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    if (data)
+        *data = cell->item.data;
+    if (is_dynamic)
+        *is_dynamic = cell->item.is_dynamic;
+    // marking cell as free for the next lap
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    return true;
+}
+
+void lfqueue_free(lfqueue *queue) {
+    if (queue) {
+        void *data = NULL;
+        bool is_dynamic = false;
+        while (lfqueue_pop(queue, &data, &is_dynamic))
+            if (is_dynamic)
+                free(data);
+        lw_free(queue->allocator, queue->cells);
+        lw_free(queue->allocator, queue);
+    }
+}
+
+// index that marks end of the stack
+#define LFSTACK_NIL UINT32_MAX
+
+struct lfstack {
+    list *nodes;
+    _Atomic uint32_t *next;
+    size_t capacity;
+    const lw_allocator *allocator;
+    char pad1[CACHE_LINE_SIZE];
+    // top of the stack: change counter in high half (against ABA), node index in low half
+    _Atomic uint64_t head;
+    char pad2[CACHE_LINE_SIZE];
+    _Atomic uint64_t free_head;
+    char pad3[CACHE_LINE_SIZE];
+};
+
+static uint32_t lfstack_take(lfstack *stack, _Atomic uint64_t *head) {
+    uint64_t old_head = atomic_load_explicit(head, memory_order_acquire);
+    uint32_t index = (uint32_t)old_head;
+    bool done = false;
+    while (!done && index != LFSTACK_NIL) {
+        uint64_t next = atomic_load_explicit(&stack->next[index], memory_order_relaxed);
+        uint64_t new_head = (((old_head >> 32) + 1) << 32) | next;
+        done = atomic_compare_exchange_weak_explicit(head, &old_head, new_head,
+                                                     memory_order_acquire, memory_order_acquire);
+        if (!done)
+            index = (uint32_t)old_head;
+    }
+    return index;
+}
+
+static void lfstack_put(lfstack *stack, _Atomic uint64_t *head, uint32_t index) {
+    uint64_t old_head = atomic_load_explicit(head, memory_order_relaxed);
+    uint64_t new_head = 0;
+    do {
+        atomic_store_explicit(&stack->next[index], (uint32_t)old_head, memory_order_relaxed);
+        new_head = (((old_head >> 32) + 1) << 32) | index;
+    } while (!atomic_compare_exchange_weak_explicit(head, &old_head, new_head,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+lfstack *lfstack_create(size_t capacity, const lw_allocator *allocator) {
+    if (allocator == NULL)
+        allocator = global_allocator;
+    if (capacity == 0 || capacity >= LFSTACK_NIL) {
+        fprintf(stderr, "ERROR (lfstack): capacity must be in range (1 - %u)\n", LFSTACK_NIL - 1);
+        return NULL;
+    }
+    lfstack *stack = lw_alloc(allocator, sizeof(lfstack), LW_MEM_LIST);
+    if (stack) {
+        stack->nodes = lw_alloc(allocator, capacity * sizeof(list), LW_MEM_LIST);
+        stack->next = lw_alloc(allocator, capacity * sizeof(_Atomic uint32_t), LW_MEM_LIST);
+        if (stack->nodes == NULL || stack->next == NULL) {
+            fprintf(stderr, "ERROR (lfstack): error during malloc\n");
+            lw_free(allocator, stack->nodes);
+            lw_free(allocator, stack->next);
+            lw_free(allocator, stack);
+            return NULL;
+        }
+        stack->capacity = capacity;
+        stack->allocator = allocator;
+        // every node starts in free list, nodes are never returned to allocator until lfstack_free
+        for (size_t i = 0; i < capacity; i++) {
+            stack->nodes[i].next_node = NULL;
+            atomic_init(&stack->next[i], i + 1 < capacity ? i + 1 : LFSTACK_NIL);
+        }
+        atomic_init(&stack->head, LFSTACK_NIL);
+        atomic_init(&stack->free_head, 0);
+    }
+    return stack;
+}
+
+bool lfstack_push(lfstack *stack, void *data, bool is_dynamic) {
+    uint32_t index = lfstack_take(stack, &stack->free_head);
+    if (index == LFSTACK_NIL)
+        return false;
+    stack->nodes[index].data = data;
+    stack->nodes[index].is_dynamic = is_dynamic;
+    lfstack_put(stack, &stack->head, index);
+    return true;
+}
+
+bool lfstack_pop(lfstack *stack, void **data, bool *is_dynamic) {
+    uint32_t index = lfstack_take(stack, &stack->head);
+    if (index == LFSTACK_NIL)
+        return false;
+    if (data)
+        *data = stack->nodes[index].data;
+    if (is_dynamic)
+        *is_dynamic = stack->nodes[index].is_dynamic;
+    lfstack_put(stack, &stack->free_head, index);
+    return true;
+}
+
+void lfstack_free(lfstack *stack) {
+    if (stack) {
+        void *data = NULL;
+        bool is_dynamic = false;
+        while (lfstack_pop(stack, &data, &is_dynamic))
+            if (is_dynamic)
+                free(data);
+        lw_free(stack->allocator, stack->nodes);
+        lw_free(stack->allocator, (void *)stack->next);
+        lw_free(stack->allocator, stack);
+    }
+}
+
 char *data_to_binary_string(const void *data, unsigned char bits) {
     char *bits_str = malloc(bits + 1);
     bits_str[bits] = 0;
@@ -185,60 +846,653 @@ void print_binary(const void *data, unsigned char bits) {
     free(bits_str);
 }
 
-bool capp_assert(char *command1, char *command2, bool suppress_msg) {
-    FILE *pipe1, *pipe2;
-    bool error = false;
-    pipe1 = popen(command1, "r");
-    pipe2 = popen(command2, "r");
-    if (pipe1 && pipe2) {
-        size_t line_count = 1;
-        ssize_t read1 = 0, read2 = 0;
-        char *buf_ptr1 = NULL, *buf_ptr2 = NULL;
-        size_t mem_len1 = 0, mem_len2 = 0;
-        do {
-            read1 = getline(&buf_ptr1, &mem_len1, pipe1);
-            read2 = getline(&buf_ptr2, &mem_len2, pipe2);
-            if (!(read1 < 0 && read2 < 0) && (read1 < 0 || read2 < 0 || strcmp(buf_ptr1, buf_ptr2) != 0)) {
-                if (!suppress_msg) {
-                    size_t eol = 0;
-                    if (read1 > 0) {
-                        eol = min_long(strcspn(buf_ptr1, "\n"), read1);
-                        if (eol)
-                            buf_ptr1[eol] = 0;
-                    }
-                    if (read2 > 0) {
-                        eol = min_long(strcspn(buf_ptr2, "\n"), read2);
-                        if (eol)
-                            buf_ptr2[eol] = 0;
-                    }
-                    printf("=== Command output assertion FAILED ===\n");
-                    printf("line: %zu\n\"%s\" != \"%s\"\n\"%s\" != \"%s\"\n", line_count, command1, \
-                            command2 , buf_ptr1 ? buf_ptr1 : "NULL", buf_ptr2 ? buf_ptr2 : "NULL");
-                    printf("=== END ===\n");
+#define CAPP_BLOCK_SIZE 65536
+
+static size_t count_lines(const char *buf, size_t len) {
+    size_t lines = 0;
+    const char *end = buf + len;
+    while (buf < end && (buf = memchr(buf, '\n', end - buf)) != NULL) {
+        lines++;
+        buf++;
+    }
+    return lines;
+}
+
+// collects the mismatching line: common prefix from previous blocks, rest of the block and,
+// if line continues past the block, rest of the line from pipe
+static char *capp_get_line(FILE *pipe, const char *prefix, size_t prefix_len,
+                           const char *rest, size_t rest_len, bool has_more) {
+    size_t eol = 0;
+    while (eol < rest_len && rest[eol] != '\n')
+        eol++;
+    char *tail = NULL;
+    ssize_t tail_len = -1;
+    if (eol == rest_len && has_more) {
+        size_t mem_len = 0;
+        tail_len = getline(&tail, &mem_len, pipe);
+    }
+    bool got_tail = tail_len >= 0;
+    if (!got_tail)
+        tail_len = 0;
+    char *line = NULL;
+    if (prefix_len || rest_len || got_tail) {
+        line = malloc(prefix_len + eol + tail_len + 1);
+        if (line) {
+            if (prefix_len)
+                memcpy(line, prefix, prefix_len);
+            memcpy(line + prefix_len, rest, eol);
+            if (tail_len)
+                memcpy(line + prefix_len + eol, tail, tail_len);
+            line[prefix_len + eol + tail_len] = 0;
+        }
+    }
+    free(tail);
+    return line;
+}
+
+// true if block has only newline after pos and stream ends with it
+static bool capp_newline_at_end(FILE *pipe, const char *buf, size_t len, size_t pos) {
+    if (len != pos + 1 || buf[pos] != '\n')
+        return false;
+    if (len < CAPP_BLOCK_SIZE)
+        return true;
+    int c = getc(pipe);
+    if (c != EOF)
+        ungetc(c, pipe);
+    return c == EOF;
+}
+
+// if exact is false, outputs that differ only by newline after the last line are equal (as lines are)
+static void capp_compare_streams(FILE *pipe1, FILE *pipe2, bool exact, capp_result *result) {
+    char *buf1 = malloc(CAPP_BLOCK_SIZE);
+    char *buf2 = malloc(CAPP_BLOCK_SIZE);
+    // bytes of the current line that were matched in previous blocks
+    char *pending = NULL;
+    size_t pending_len = 0, pending_mem = 0;
+    size_t lines = 0;
+    char last = '\n';
+    bool done = false;
+    if (!buf1 || !buf2) {
+        fprintf(stderr, "ERROR (capp_assert): error during malloc\n");
+        result->failed = true;
+        result->equal = false;
+        done = true;
+    }
+    while (!done) {
+        size_t read1 = fread(buf1, 1, CAPP_BLOCK_SIZE, pipe1);
+        size_t read2 = fread(buf2, 1, CAPP_BLOCK_SIZE, pipe2);
+        if (read1 == read2 && memcmp(buf1, buf2, read1) == 0) {
+            size_t line_start = read1;
+            while (line_start && buf1[line_start - 1] != '\n')
+                line_start--;
+            if (line_start)
+                pending_len = 0;
+            if (pending_len + read1 - line_start > pending_mem) {
+                pending_mem = max_size(pending_len + read1 - line_start, pending_mem * 2);
+                char *new_pending = realloc(pending, pending_mem);
+                if (new_pending == NULL) {
+                    free(pending);
+                    pending_mem = 0;
+                    pending_len = 0;
                 }
-                error = true;
+                pending = new_pending;
+            }
+            if (pending) {
+                memcpy(pending + pending_len, buf1 + line_start, read1 - line_start);
+                pending_len += read1 - line_start;
+            }
+            lines += count_lines(buf1, read1);
+            result->bytes += read1;
+            if (read1)
+                last = buf1[read1 - 1];
+            done = read1 < CAPP_BLOCK_SIZE;
+        } else {
+            // falling back to line level to report the first difference
+            size_t common = min_size(read1, read2);
+            size_t pos = 0;
+            while (pos < common && buf1[pos] == buf2[pos])
+                pos++;
+            const bool newline_only = !exact && (pos ? buf1[pos - 1] : last) != '\n' &&
+                ((read2 == pos && capp_newline_at_end(pipe1, buf1, read1, pos)) ||
+                 (read1 == pos && capp_newline_at_end(pipe2, buf2, read2, pos)));
+            result->bytes += pos;
+            if (!newline_only) {
+                size_t line_start = pos;
+                while (line_start && buf1[line_start - 1] != '\n')
+                    line_start--;
+                lines += count_lines(buf1, line_start);
+                if (line_start)
+                    pending_len = 0;
+                result->equal = false;
+                result->line = lines + 1;
+                result->line1 = capp_get_line(pipe1, pending, pending_len, buf1 + line_start,
+                                              read1 - line_start, read1 == CAPP_BLOCK_SIZE);
+                result->line2 = capp_get_line(pipe2, pending, pending_len, buf2 + line_start,
+                                              read2 - line_start, read2 == CAPP_BLOCK_SIZE);
             }
-            line_count++;
-        } while (read1 >= 0 && read2 >= 0 && !error);
-        if (buf_ptr1) free(buf_ptr1);
-        if (buf_ptr2) free(buf_ptr2);
+            done = true;
+        }
     }
-    pclose(pipe1);
-    pclose(pipe2);
-    return !error;
+    free(pending);
+    free(buf1);
+    free(buf2);
+}
+
+static double get_time_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void capp_run_pair(const char *command1, const char *command2, bool exact, capp_result *result) {
+#if defined(__GLIBC__)
+    // close-on-exec, so concurrently started commands dont hold each others pipes open
+    const char *mode = "re";
+#else
+    const char *mode = "r";
+#endif
+    double start = get_time_seconds();
+    memset(result, 0, sizeof(capp_result));
+    result->equal = true;
+    FILE *pipe1 = popen(command1, mode);
+    FILE *pipe2 = popen(command2, mode);
+    if (pipe1 && pipe2) {
+        capp_compare_streams(pipe1, pipe2, exact, result);
+    } else {
+        result->failed = true;
+        result->equal = false;
+    }
+    if (pipe1)
+        pclose(pipe1);
+    if (pipe2)
+        pclose(pipe2);
+    result->seconds = get_time_seconds() - start;
+}
+
+bool capp_assert(char *command1, char *command2, bool suppress_msg) {
+    capp_result result;
+    capp_run_pair(command1, command2, false, &result);
+    if (!result.equal && !suppress_msg) {
+        printf("=== Command output assertion FAILED ===\n");
+        printf("line: %zu\n\"%s\" != \"%s\"\n\"%s\" != \"%s\"\n", result.line, command1, \
+                command2 , result.line1 ? result.line1 : "NULL", result.line2 ? result.line2 : "NULL");
+        printf("=== END ===\n");
+    }
+    free(result.line1);
+    free(result.line2);
+    return result.equal;
+}
+
+typedef struct {
+    const capp_pair *pairs;
+    capp_result *results;
+    size_t count;
+    size_t next;
+    pthread_mutex_t lock;
+} capp_batch;
+
+static void *capp_batch_worker(void *arg) {
+    capp_batch *batch = arg;
+    bool done = false;
+    while (!done) {
+        pthread_mutex_lock(&batch->lock);
+        size_t index = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (index < batch->count)
+            capp_run_pair(batch->pairs[index].command1, batch->pairs[index].command2, true,
+                          &batch->results[index]);
+        else
+            done = true;
+    }
+    return NULL;
+}
+
+capp_result *capp_assert_batch(const capp_pair *pairs, size_t count, size_t workers) {
+    capp_result *results = calloc(max_size(count, 1), sizeof(capp_result));
+    if (results == NULL) {
+        fprintf(stderr, "ERROR (capp_assert_batch): error during malloc\n");
+        return NULL;
+    }
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? cpus : 1;
+    }
+    workers = min_size(workers, max_size(count, 1));
+    capp_batch batch = {pairs, results, count, 0, PTHREAD_MUTEX_INITIALIZER};
+    // calling thread is one of the workers
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    size_t started = 0;
+    while (threads && started < workers - 1 &&
+           pthread_create(&threads[started], NULL, capp_batch_worker, &batch) == 0)
+        started++;
+    capp_batch_worker(&batch);
+    for (size_t i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&batch.lock);
+    return results;
+}
+
+void capp_results_free(capp_result *results, size_t count) {
+    if (results) {
+        for (size_t i = 0; i < count; i++) {
+            free(results[i].line1);
+            free(results[i].line2);
+        }
+        free(results);
+    }
+}
+
+static _Atomic int simd_level = -1;
+
+static lw_simd_level detect_simd_level(void) {
+    lw_simd_level level = LW_SIMD_SCALAR;
+#if defined(LW_X86_DISPATCH)
+    __builtin_cpu_init();
+    // UTF-8 kernels of both levels are compiled with popcnt
+    if (__builtin_cpu_supports("popcnt")) {
+        if (__builtin_cpu_supports("avx2"))
+            level = LW_SIMD_AVX2;
+        else if (__builtin_cpu_supports("sse4.2"))
+            level = LW_SIMD_SSE4;
+    }
+#endif
+    return level;
+}
+
+lw_simd_level lw_get_simd_level(void) {
+    int level = atomic_load_explicit(&simd_level, memory_order_relaxed);
+    if (level < 0) {
+        level = detect_simd_level();
+        atomic_store_explicit(&simd_level, level, memory_order_relaxed);
+    }
+    return (lw_simd_level)level;
+}
+
+lw_simd_level lw_set_simd_level(lw_simd_level level) {
+    lw_simd_level supported = detect_simd_level();
+    if (level > supported)
+        level = supported;
+    atomic_store_explicit(&simd_level, level, memory_order_relaxed);
+    return level;
+}
+
+// portable kernels, also used for tails of vector kernels
+#define DEFINE_SCALAR_KERNELS(T, suffix)                              \
+static void clamp_##suffix##_scalar(T *arr, size_t n, T min, T max) { \
+    for (size_t i = 0; i < n; i++) {                                  \
+        const T t = arr[i] < min ? min : arr[i];                      \
+        arr[i] = t > max ? max : t;                                   \
+    }                                                                 \
+}                                                                     \
+static T min_##suffix##_scalar(const T *arr, size_t n, T identity) {  \
+    T m = identity;                                                   \
+    for (size_t i = 0; i < n; i++)                                    \
+        m = arr[i] < m ? arr[i] : m;                                  \
+    return m;                                                         \
+}                                                                     \
+static T max_##suffix##_scalar(const T *arr, size_t n, T identity) {  \
+    T m = identity;                                                   \
+    for (size_t i = 0; i < n; i++)                                    \
+        m = arr[i] > m ? arr[i] : m;                                  \
+    return m;                                                         \
+}                                                                     \
+static size_t find_##suffix##_scalar(const T *arr, size_t n, T key) { \
+    size_t i = 0;                                                     \
+    while (i < n && !(arr[i] == key))                                 \
+        i++;                                                          \
+    return i;                                                         \
+}
+
+DEFINE_SCALAR_KERNELS(int32_t, int32)
+DEFINE_SCALAR_KERNELS(int64_t, int64)
+DEFINE_SCALAR_KERNELS(double, double)
+
+#if defined(LW_X86_DISPATCH)
+/*
+    Vector kernels. VMIN(x, acc) and VMAX(x, acc) return acc when x is NaN, so NaNs are skipped by
+    reductions, clamp computes VMIN(max, VMAX(min, x)) that keeps NaN as is, same as scalar kernels.
+*/
+#define DEFINE_VECTOR_KERNELS(T, suffix, isa, features, V, LANES, LOAD, STORE, SET1, VMIN, VMAX, EQ_LANE) \
+__attribute__((target(features)))                                                                         \
+static void clamp_##suffix##_##isa(T *arr, size_t n, T min, T max) {                                      \
+    const V vmin = SET1(min), vmax = SET1(max);                                                           \
+    size_t i = 0;                                                                                         \
+    for (; i + LANES <= n; i += LANES)                                                                    \
+        STORE(arr + i, VMIN(vmax, VMAX(vmin, LOAD(arr + i))));                                            \
+    clamp_##suffix##_scalar(arr + i, n - i, min, max);                                                    \
+}                                                                                                         \
+__attribute__((target(features)))                                                                         \
+static T min_##suffix##_##isa(const T *arr, size_t n, T identity) {                                       \
+    V acc = SET1(identity);                                                                               \
+    size_t i = 0;                                                                                         \
+    for (; i + LANES <= n; i += LANES)                                                                    \
+        acc = VMIN(LOAD(arr + i), acc);                                                                   \
+    T lanes[LANES];                                                                                       \
+    STORE(lanes, acc);                                                                                    \
+    return min_##suffix##_scalar(arr + i, n - i, min_##suffix##_scalar(lanes, LANES, identity));          \
+}                                                                                                         \
+__attribute__((target(features)))                                                                         \
+static T max_##suffix##_##isa(const T *arr, size_t n, T identity) {                                       \
+    V acc = SET1(identity);                                                                               \
+    size_t i = 0;                                                                                         \
+    for (; i + LANES <= n; i += LANES)                                                                    \
+        acc = VMAX(LOAD(arr + i), acc);                                                                   \
+    T lanes[LANES];                                                                                       \
+    STORE(lanes, acc);                                                                                    \
+    return max_##suffix##_scalar(arr + i, n - i, max_##suffix##_scalar(lanes, LANES, identity));          \
+}                                                                                                         \
+__attribute__((target(features)))                                                                         \
+static size_t find_##suffix##_##isa(const T *arr, size_t n, T key) {                                      \
+    const V vkey = SET1(key);                                                                             \
+    size_t i = 0;                                                                                         \
+    for (; i + LANES <= n; i += LANES) {                                                                  \
+        int lane = EQ_LANE(LOAD(arr + i), vkey);                                                          \
+        if (lane >= 0)                                                                                    \
+            return i + lane;                                                                              \
+    }                                                                                                     \
+    return i + find_##suffix##_scalar(arr + i, n - i, key);                                               \
+}
+
+// index of first set lane in mask of movemask_epi8 (lane_bytes bits per lane), -1 if none
+#define MASK_LANE(mask, lane_bytes) ((mask) ? (int)(__builtin_ctz(mask) / (lane_bytes)) : -1)
+
+#define SSE_LOADI(p) _mm_loadu_si128((const __m128i *)(p))
+#define SSE_STOREI(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define SSE_EQ32(a, b) MASK_LANE((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)), 4)
+#define SSE_EQ64(a, b) MASK_LANE((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi64(a, b)), 8)
+#define SSE_EQPD(a, b) MASK_LANE((unsigned)_mm_movemask_pd(_mm_cmpeq_pd(a, b)), 1)
+#define AVX_LOADI(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AVX_STOREI(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define AVX_EQ32(a, b) MASK_LANE((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)), 4)
+#define AVX_EQ64(a, b) MASK_LANE((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi64(a, b)), 8)
+#define AVX_EQPD(a, b) MASK_LANE((unsigned)_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)), 1)
+
+// there is no 64 bit integer min/max before avx512, using compare and blend
+__attribute__((target("sse4.2")))
+static inline __m128i sse_min_epi64(__m128i a, __m128i b) {
+    return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(a, b));
+}
+
+__attribute__((target("sse4.2")))
+static inline __m128i sse_max_epi64(__m128i a, __m128i b) {
+    return _mm_blendv_epi8(b, a, _mm_cmpgt_epi64(a, b));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx_min_epi64(__m256i a, __m256i b) {
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx_max_epi64(__m256i a, __m256i b) {
+    return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+DEFINE_VECTOR_KERNELS(int32_t, int32, sse4, "sse4.2", __m128i, 4, SSE_LOADI, SSE_STOREI,
+                      _mm_set1_epi32, _mm_min_epi32, _mm_max_epi32, SSE_EQ32)
+DEFINE_VECTOR_KERNELS(int64_t, int64, sse4, "sse4.2", __m128i, 2, SSE_LOADI, SSE_STOREI,
+                      _mm_set1_epi64x, sse_min_epi64, sse_max_epi64, SSE_EQ64)
+DEFINE_VECTOR_KERNELS(double, double, sse4, "sse4.2", __m128d, 2, _mm_loadu_pd, _mm_storeu_pd,
+                      _mm_set1_pd, _mm_min_pd, _mm_max_pd, SSE_EQPD)
+DEFINE_VECTOR_KERNELS(int32_t, int32, avx2, "avx2", __m256i, 8, AVX_LOADI, AVX_STOREI,
+                      _mm256_set1_epi32, _mm256_min_epi32, _mm256_max_epi32, AVX_EQ32)
+DEFINE_VECTOR_KERNELS(int64_t, int64, avx2, "avx2", __m256i, 4, AVX_LOADI, AVX_STOREI,
+                      _mm256_set1_epi64x, avx_min_epi64, avx_max_epi64, AVX_EQ64)
+DEFINE_VECTOR_KERNELS(double, double, avx2, "avx2", __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd,
+                      _mm256_set1_pd, _mm256_min_pd, _mm256_max_pd, AVX_EQPD)
+
+#define DISPATCH(kernel, suffix, ...)                                              \
+    (lw_get_simd_level() == LW_SIMD_AVX2 ? kernel##_##suffix##_avx2(__VA_ARGS__) : \
+     lw_get_simd_level() == LW_SIMD_SSE4 ? kernel##_##suffix##_sse4(__VA_ARGS__) : \
+     kernel##_##suffix##_scalar(__VA_ARGS__))
+#else
+#define DISPATCH(kernel, suffix, ...) kernel##_##suffix##_scalar(__VA_ARGS__)
+#endif
+
+// public array functions for type T, lowest and highest are identities of max and min
+#define DEFINE_ARRAY_FUNCTIONS(T, suffix, lowest, highest)               \
+void clamp_##suffix##_array(T *arr, size_t n, T min, T max) {            \
+    DISPATCH(clamp, suffix, arr, n, min, max);                           \
+}                                                                        \
+T min_##suffix##_array(const T *arr, size_t n) {                         \
+    return DISPATCH(min, suffix, arr, n, highest);                       \
+}                                                                        \
+T max_##suffix##_array(const T *arr, size_t n) {                         \
+    return DISPATCH(max, suffix, arr, n, lowest);                        \
+}                                                                        \
+size_t argmin_##suffix##_array(const T *arr, size_t n) {                 \
+    return DISPATCH(find, suffix, arr, n, min_##suffix##_array(arr, n)); \
+}                                                                        \
+size_t argmax_##suffix##_array(const T *arr, size_t n) {                 \
+    return DISPATCH(find, suffix, arr, n, max_##suffix##_array(arr, n)); \
+}
+
+DEFINE_ARRAY_FUNCTIONS(int32_t, int32, INT32_MIN, INT32_MAX)
+DEFINE_ARRAY_FUNCTIONS(int64_t, int64, INT64_MIN, INT64_MAX)
+DEFINE_ARRAY_FUNCTIONS(double, double, -INFINITY, INFINITY)
+
+// long is one of fixed size types, so it reuses their kernels
+#if LONG_MAX == INT64_MAX
+#define LONG_SUFFIX int64
+#define LONG_FIXED int64_t
+#else
+#define LONG_SUFFIX int32
+#define LONG_FIXED int32_t
+#endif
+#define LONG_CALL(function, suffix) function##_##suffix##_array
+#define LONG_FUNCTION(function, suffix) LONG_CALL(function, suffix)
+
+void clamp_long_array(long *arr, size_t n, long min, long max) {
+    LONG_FUNCTION(clamp, LONG_SUFFIX)((LONG_FIXED *)arr, n, min, max);
+}
+
+long min_long_array(const long *arr, size_t n) {
+    return LONG_FUNCTION(min, LONG_SUFFIX)((const LONG_FIXED *)arr, n);
+}
+
+long max_long_array(const long *arr, size_t n) {
+    return LONG_FUNCTION(max, LONG_SUFFIX)((const LONG_FIXED *)arr, n);
+}
+
+size_t argmin_long_array(const long *arr, size_t n) {
+    return LONG_FUNCTION(argmin, LONG_SUFFIX)((const LONG_FIXED *)arr, n);
+}
+
+size_t argmax_long_array(const long *arr, size_t n) {
+    return LONG_FUNCTION(argmax, LONG_SUFFIX)((const LONG_FIXED *)arr, n);
+}
+
+// portable UTF-8 validation (RFC 3629: no overlong forms, surrogates or code points above U+10FFFF)
+static bool utf8_validate_scalar(const char *str, size_t len) {
+    const unsigned char *s = (const unsigned char *)str;
+    size_t i = 0;
+    while (i < len) {
+        // skipping ascii 8 bytes at the time
+        uint64_t block;
+        if (i + sizeof(block) <= len) {
+            memcpy(&block, s + i, sizeof(block));
+            if (!(block & UINT64_C(0x8080808080808080))) {
+                i += sizeof(block);
+                continue;
+            }
+        }
+        unsigned char c = s[i];
+        size_t size = 1;
+        unsigned char lo = 0x80, hi = 0xBF;  // range of the second byte
+        if (c < 0x80) {
+            i++;
+            continue;
+        } else if (c >= 0xC2 && c <= 0xDF) {
+            size = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            size = 3;
+            lo = c == 0xE0 ? 0xA0 : 0x80;
+            hi = c == 0xED ? 0x9F : 0xBF;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            size = 4;
+            lo = c == 0xF0 ? 0x90 : 0x80;
+            hi = c == 0xF4 ? 0x8F : 0xBF;
+        } else {
+            return false;
+        }
+        if (len - i < size || s[i + 1] < lo || s[i + 1] > hi)
+            return false;
+        for (size_t j = 2; j < size; j++) {
+            if ((s[i + j] & 0xC0) != 0x80)
+                return false;
+        }
+        i += size;
+    }
+    return true;
 }
 
-long max_long(long a, long b) {
-    return a > b ? a : b;
+// code points are counted as bytes that are not continuation bytes (10xxxxxx)
+static size_t utf8_count_scalar(const char *str, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++)
+        count += ((unsigned char)str[i] & 0xC0) != 0x80;
+    return count;
 }
 
-long min_long(long a, long b) {
-    return a < b ? a : b;
+#if defined(LW_X86_DISPATCH)
+/*
+    Vector UTF-8 validation with lookup algorithm (Keiser, Lemire "Validating UTF-8 In Less Than One
+    Instruction Per Byte"). Every error is recognized by high nibble of previous byte, its low nibble and
+    high nibble of current byte, each nibble looks up bit set of errors it allows and the AND of three sets
+    is non zero only for invalid pairs. Third and fourth bytes of long sequences are checked by looking
+    two and three bytes back.
+*/
+#define UTF8_TOO_SHORT (1 << 0)  // lead byte or ascii after lead byte
+#define UTF8_TOO_LONG (1 << 1)  // continuation byte after ascii
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTS (1 << 7)  // two continuation bytes, valid only inside 3 and 4 byte sequences
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+static const uint8_t utf8_byte_1_high[16] = {
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+static const uint8_t utf8_byte_1_low[16] = {
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    UTF8_CARRY,
+    UTF8_CARRY,
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const uint8_t utf8_byte_2_high[16] = {
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000
+        | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+// block is incomplete when one of its last three bytes starts sequence longer than rest of the block
+static const uint8_t utf8_incomplete_max[32] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+
+#define DEFINE_UTF8_KERNELS(isa, features, V, LANES, LOAD, TABLE, SET1, PREV, MOVEMASK, TESTZ, \
+                            AND, OR, XOR, SUBS, SRLI16, CMPGT, SHUFFLE)                        \
+__attribute__((target(features)))                                                              \
+static inline V utf8_lookup_##isa(const uint8_t *table, V nibbles) {                           \
+    return SHUFFLE(TABLE(table), AND(nibbles, SET1(0x0F)));                                    \
+}                                                                                              \
+__attribute__((target(features)))                                                              \
+static inline V utf8_check_block_##isa(V input, V prev_input) {                                \
+    V prev1 = PREV(input, prev_input, 1);                                                      \
+    V special = AND(AND(utf8_lookup_##isa(utf8_byte_1_high, SRLI16(prev1, 4)),                 \
+                        utf8_lookup_##isa(utf8_byte_1_low, prev1)),                            \
+                    utf8_lookup_##isa(utf8_byte_2_high, SRLI16(input, 4)));                    \
+    V is_third = SUBS(PREV(input, prev_input, 2), SET1(0xE0 - 0x80));                          \
+    V is_fourth = SUBS(PREV(input, prev_input, 3), SET1(0xF0 - 0x80));                         \
+    return XOR(special, AND(OR(is_third, is_fourth), SET1(0x80)));                             \
+}                                                                                              \
+__attribute__((target(features)))                                                              \
+static bool utf8_validate_##isa(const char *str, size_t len) {                                 \
+    const V max_incomplete = LOAD(utf8_incomplete_max + sizeof(utf8_incomplete_max) - LANES);  \
+    V error = SET1(0), prev_input = SET1(0), prev_incomplete = SET1(0);                        \
+    char tail[LANES];                                                                          \
+    for (size_t i = 0; i < len; i += LANES) {                                                  \
+        V input;                                                                               \
+        if (i + LANES <= len) {                                                                \
+            input = LOAD(str + i);                                                             \
+        } else {                                                                               \
+            memset(tail, 0, LANES);                                                            \
+            memcpy(tail, str + i, len - i);                                                    \
+            input = LOAD(tail);                                                                \
+        }                                                                                      \
+        if (MOVEMASK(input) == 0) {                                                            \
+            error = OR(error, prev_incomplete);                                                \
+        } else {                                                                               \
+            error = OR(error, utf8_check_block_##isa(input, prev_input));                      \
+            prev_incomplete = SUBS(input, max_incomplete);                                     \
+        }                                                                                      \
+        prev_input = input;                                                                    \
+    }                                                                                          \
+    return TESTZ(OR(error, prev_incomplete));                                                  \
+}                                                                                              \
+__attribute__((target(features)))                                                              \
+static size_t utf8_count_##isa(const char *str, size_t len) {                                  \
+    size_t count = 0, i = 0;                                                                   \
+    for (; i + LANES <= len; i += LANES)                                                       \
+        count += __builtin_popcount((unsigned)MOVEMASK(CMPGT(LOAD(str + i), SET1(0xBF))));     \
+    return count + utf8_count_scalar(str + i, len - i);                                        \
 }
 
-long clamp_long(long d, long min, long max) {
-    const long t = d < min ? min : d;
-    return t > max ? max : t;
+#define SSE_SET1_8(x) _mm_set1_epi8((char)(x))
+#define SSE_TABLE(table) SSE_LOADI(table)
+#define SSE_PREV(input, prev, n) _mm_alignr_epi8(input, prev, 16 - (n))
+#define SSE_TESTZ(v) _mm_testz_si128(v, v)
+#define AVX_SET1_8(x) _mm256_set1_epi8((char)(x))
+#define AVX_TABLE(table) _mm256_broadcastsi128_si256(SSE_LOADI(table))
+// bytes of previous block are taken across 128 bit lanes
+#define AVX_PREV(input, prev, n) \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+#define AVX_TESTZ(v) _mm256_testz_si256(v, v)
+
+DEFINE_UTF8_KERNELS(sse4, "sse4.2,popcnt", __m128i, 16, SSE_LOADI, SSE_TABLE, SSE_SET1_8, SSE_PREV,
+                    _mm_movemask_epi8, SSE_TESTZ, _mm_and_si128, _mm_or_si128, _mm_xor_si128, _mm_subs_epu8,
+                    _mm_srli_epi16, _mm_cmpgt_epi8, _mm_shuffle_epi8)
+DEFINE_UTF8_KERNELS(avx2, "avx2,popcnt", __m256i, 32, AVX_LOADI, AVX_TABLE, AVX_SET1_8, AVX_PREV,
+                    _mm256_movemask_epi8, AVX_TESTZ, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256,
+                    _mm256_subs_epu8, _mm256_srli_epi16, _mm256_cmpgt_epi8, _mm256_shuffle_epi8)
+#endif
+
+bool utf8_validate(const char *str, const size_t len) {
+    return str ? DISPATCH(utf8, validate, str, len) : len == 0;
+}
+
+size_t utf8_length(const char *str, const size_t len) {
+    return str ? DISPATCH(utf8, count, str, len) : 0;
 }
 
 bool is_number(const char *str) {
@@ -254,17 +1508,264 @@ bool is_number(const char *str) {
     return !error;
 }
 
+#if defined(__SSE2__)
+// reverses order of 16 bytes in register
+static inline __m128i reverse_block(__m128i v) {
+#if defined(__SSSE3__)
+    const __m128i mask = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm_shuffle_epi8(v, mask);
+#else
+    // no pshufb: reverse dwords, then words inside dwords, then bytes inside words
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+#endif
+}
+
+static inline void reverse_store(char *dest, const char *src) {
+    _mm_storeu_si128((__m128i *)dest, reverse_block(_mm_loadu_si128((const __m128i *)src)));
+}
+#define REVERSE_BLOCK_SIZE 16
+#elif defined(__ARM_NEON)
+static inline void reverse_store(char *dest, const char *src) {
+    uint8x16_t v = vrev64q_u8(vld1q_u8((const uint8_t *)src));
+    vst1q_u8((uint8_t *)dest, vextq_u8(v, v, 8));
+}
+#define REVERSE_BLOCK_SIZE 16
+#else
+static inline void reverse_store(char *dest, const char *src) {
+    uint64_t v;
+    memcpy(&v, src, sizeof(v));
+#if defined(__GNUC__)
+    v = __builtin_bswap64(v);
+#else
+    v = ((v & 0x00000000FFFFFFFFULL) << 32) | ((v & 0xFFFFFFFF00000000ULL) >> 32);
+    v = ((v & 0x0000FFFF0000FFFFULL) << 16) | ((v & 0xFFFF0000FFFF0000ULL) >> 16);
+    v = ((v & 0x00FF00FF00FF00FFULL) << 8) | ((v & 0xFF00FF00FF00FF00ULL) >> 8);
+#endif
+    memcpy(dest, &v, sizeof(v));
+}
+#define REVERSE_BLOCK_SIZE 8
+#endif
+
+void str_reverse_n(char *str, const size_t len) {
+    char *lo = str;
+    char *hi = str + len;
+    char block[REVERSE_BLOCK_SIZE];
+    // swapping whole blocks from both ends while they dont overlap
+    while (hi - lo >= 2 * REVERSE_BLOCK_SIZE) {
+        hi -= REVERSE_BLOCK_SIZE;
+        memcpy(block, lo, REVERSE_BLOCK_SIZE);
+        reverse_store(lo, hi);
+        reverse_store(hi, block);
+        lo += REVERSE_BLOCK_SIZE;
+    }
+    while (hi - lo > 1) {
+        char t = *lo;
+        *lo++ = *--hi;
+        *hi = t;
+    }
+}
+
 void str_reverse(char *str) {
-    size_t len = strlen(str);
-    for (size_t i = 0; i < len / 2; i++) {
-        char t = str[i];
-        str[i] = str[len - 1 - i];
-        str[len - 1 - i] = t;
+    str_reverse_n(str, strlen(str));
+}
+
+char *str_reverse_copy(char *dest, const char *src, const size_t len) {
+    size_t i = 0;
+    for (; i + REVERSE_BLOCK_SIZE <= len; i += REVERSE_BLOCK_SIZE)
+        reverse_store(dest + i, src + len - i - REVERSE_BLOCK_SIZE);
+    for (; i < len; i++)
+        dest[i] = src[len - 1 - i];
+    dest[len] = 0;
+    return dest;
+}
+
+#if defined(__SSE2__)
+#define FIND_BLOCK_SIZE 16
+#define FIND_MASK_BITS 1
+// bit i of the mask is set when byte i of the block equals c
+static inline uint64_t find_eq_mask(const char *block, const char c) {
+    __m128i v = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)block), _mm_set1_epi8(c));
+    return (uint32_t)_mm_movemask_epi8(v);
+}
+#elif defined(__ARM_NEON)
+#define FIND_BLOCK_SIZE 16
+#define FIND_MASK_BITS 4
+// no movemask on NEON: narrowing shift leaves 4 bits per byte
+static inline uint64_t find_eq_mask(const char *block, const char c) {
+    uint8x16_t v = vceqq_u8(vld1q_u8((const uint8_t *)block), vdupq_n_u8((uint8_t)c));
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+#else
+#define FIND_BLOCK_SIZE 8
+#define FIND_MASK_BITS 1
+static inline uint64_t find_eq_mask(const char *block, const char c) {
+    uint64_t mask = 0;
+    for (int i = 0; i < FIND_BLOCK_SIZE; i++)
+        mask |= (uint64_t)(block[i] == c) << i;
+    return mask;
+}
+#endif
+#define FIND_LANE_MASK ((UINT64_C(1) << FIND_MASK_BITS) - 1)
+// sets with more bytes than this are matched with lookup table instead of vector compares
+#define FIND_SET_VECTOR_MAX 8
+
+// index of the first byte set in non zero mask
+static inline size_t find_first_lane(uint64_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask) / FIND_MASK_BITS;
+#else
+    size_t i = 0;
+    while (!(mask & FIND_LANE_MASK)) {
+        mask >>= FIND_MASK_BITS;
+        i++;
+    }
+    return i;
+#endif
+}
+
+static size_t find_substring(const char *str, const size_t len, const char *needle,
+                             const size_t needle_len, size_t pos) {
+    if (needle_len > len || pos > len - needle_len)
+        return DS_NPOS;
+    if (needle_len == 0)
+        return pos;
+    if (needle_len == 1) {
+        const char *found = memchr(str + pos, needle[0], len - pos);
+        return found ? (size_t)(found - str) : DS_NPOS;
     }
+    const size_t last = needle_len - 1;
+    // candidates are positions where both first and last char of needle match
+    for (; pos + last + FIND_BLOCK_SIZE <= len; pos += FIND_BLOCK_SIZE) {
+        uint64_t mask = find_eq_mask(str + pos, needle[0]) & find_eq_mask(str + pos + last, needle[last]);
+        while (mask) {
+            size_t i = find_first_lane(mask);
+            if (memcmp(str + pos + i + 1, needle + 1, needle_len - 2) == 0)
+                return pos + i;
+            mask &= ~(FIND_LANE_MASK << (i * FIND_MASK_BITS));
+        }
+    }
+    for (; pos + last < len; pos++) {
+        if (str[pos] == needle[0] && memcmp(str + pos + 1, needle + 1, last) == 0)
+            return pos;
+    }
+    return DS_NPOS;
+}
+
+// set of bytes prepared once for many searches
+typedef struct {
+    const char *bytes;
+    size_t length;
+    bool table[UCHAR_MAX + 1];
+} byte_set;
+
+static void byte_set_init(byte_set *set, const char *bytes) {
+    set->bytes = bytes;
+    set->length = strlen(bytes);
+    memset(set->table, 0, sizeof(set->table));
+    for (size_t j = 0; j < set->length; j++)
+        set->table[(unsigned char)bytes[j]] = true;
+}
+
+static size_t find_byte_set(const char *str, const size_t len, const byte_set *set, size_t pos) {
+    if (pos >= len || set->length == 0)
+        return DS_NPOS;
+    if (set->length == 1) {
+        const char *found = memchr(str + pos, set->bytes[0], len - pos);
+        return found ? (size_t)(found - str) : DS_NPOS;
+    }
+    if (set->length <= FIND_SET_VECTOR_MAX) {
+        for (; pos + FIND_BLOCK_SIZE <= len; pos += FIND_BLOCK_SIZE) {
+            uint64_t mask = 0;
+            for (size_t j = 0; j < set->length; j++)
+                mask |= find_eq_mask(str + pos, set->bytes[j]);
+            if (mask)
+                return pos + find_first_lane(mask);
+        }
+    }
+    for (; pos < len; pos++) {
+        if (set->table[(unsigned char)str[pos]])
+            return pos;
+    }
+    return DS_NPOS;
+}
+
+// allocator of the string, strings that were not made by DS_init use malloc
+static inline const lw_allocator *DS_allocator(const dynamic_string *ds) {
+    return ds->allocator ? ds->allocator : &default_allocator;
+}
+
+// reference counter of buffer shared by several dynamic strings, buffer is read only while shared
+struct ds_shared {
+    atomic_size_t refs;
+};
+
+// every UTF8_INDEX_STRIDE-th code point has its byte offset stored in the index
+#define UTF8_INDEX_STRIDE 64
+
+// sparse code point index, built by DS_utf8_index and dropped on any modification
+struct ds_utf8_index {
+    size_t length;  // amount of code points
+    size_t offsets[];  // byte offset of code point i * UTF8_INDEX_STRIDE
+};
+
+static inline void DS_drop_utf8_index(dynamic_string *ds) {
+    if (ds->utf8_index) {
+        lw_free(DS_allocator(ds), ds->utf8_index);
+        ds->utf8_index = NULL;
+    }
+}
+
+// lets go of the buffer, it is free'd if nobody else holds it
+static void DS_drop_buffer(dynamic_string *ds) {
+    const lw_allocator *allocator = DS_allocator(ds);
+    DS_drop_utf8_index(ds);
+    if (ds->shared == NULL) {
+        lw_free(allocator, ds->string);
+    } else if (atomic_fetch_sub_explicit(&ds->shared->refs, 1, memory_order_acq_rel) == 1) {
+        lw_free(allocator, ds->string);
+        lw_free(allocator, ds->shared);
+    }
+    ds->string = NULL;
+    ds->shared = NULL;
+}
+
+// makes ds sole owner of its buffer before modification, shared text is copied into buffer of mem_size
+static bool DS_detach(dynamic_string *ds, size_t mem_size) {
+    DS_drop_utf8_index(ds);
+    if (ds->shared == NULL)
+        return true;
+    if (atomic_load_explicit(&ds->shared->refs, memory_order_acquire) == 1) {
+        // other holders are gone so buffer can be modified in place
+        lw_free(DS_allocator(ds), ds->shared);
+        ds->shared = NULL;
+        return true;
+    }
+    mem_size = max_size(mem_size, ds->length + 1);
+    char *string = lw_alloc(DS_allocator(ds), mem_size, LW_MEM_STRING);
+    if (string == NULL) {
+        fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
+        return false;
+    }
+    memcpy(string, ds->string, ds->length + 1);
+    DS_drop_buffer(ds);
+    ds->string = string;
+    ds->mem_size = mem_size;
+    return true;
+}
+
+dynamic_string *DS_reverse(dynamic_string *ds) {
+    if (ds && DS_detach(ds, ds->mem_size))
+        str_reverse_n(ds->string, ds->length);
+    return ds;
 }
 
 dynamic_string *DS_realloc(dynamic_string *dest, const size_t mem_size) {
-    dest->string = realloc(dest->string, mem_size);
+    if (!DS_detach(dest, mem_size))
+        return dest;
+    dest->string = lw_realloc(DS_allocator(dest), dest->string, mem_size, LW_MEM_STRING);
     if (dest->string == NULL)
         fprintf(stderr, "ERROR (dynamic_string): Cant realloc.\n");
     else
@@ -273,14 +1774,56 @@ dynamic_string *DS_realloc(dynamic_string *dest, const size_t mem_size) {
 }
 
 void DS_free(dynamic_string *ds) {
-    free(ds->string);
-    free(ds);
+    DS_drop_buffer(ds);
+    lw_free(DS_allocator(ds), ds);
+}
+
+dynamic_string *DS_share(dynamic_string *ds) {
+    if (ds == NULL)
+        return NULL;
+    const lw_allocator *allocator = DS_allocator(ds);
+    if (ds->shared == NULL) {
+        ds->shared = lw_alloc(allocator, sizeof(struct ds_shared), LW_MEM_STRING);
+        if (ds->shared == NULL) {
+            fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
+            return NULL;
+        }
+        atomic_init(&ds->shared->refs, 1);
+    }
+    dynamic_string *copy = lw_alloc(allocator, sizeof(dynamic_string), LW_MEM_STRING);
+    if (copy == NULL) {
+        fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
+        return NULL;
+    }
+    *copy = *ds;
+    copy->utf8_index = NULL;
+    atomic_fetch_add_explicit(&ds->shared->refs, 1, memory_order_relaxed);
+    return copy;
+}
+
+bool DS_is_shared(const dynamic_string *ds) {
+    return ds && ds->shared && atomic_load_explicit(&ds->shared->refs, memory_order_acquire) > 1;
 }
 
 dynamic_string *DS_set_text(dynamic_string *dest, char *src) {
-    if (dest) {
+    if (dest && dest->shared) {
+        // old text is replaced anyway so instead of copying it new buffer is filled from src
+        size_t src_len = strlen(src);
+        size_t new_mem_size = max_size((src_len + 1), dest->mem_size);
+        char *string = lw_alloc(DS_allocator(dest), new_mem_size, LW_MEM_STRING);
+        if (string == NULL) {
+            fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
+        } else {
+            memcpy(string, src, src_len + 1);
+            DS_drop_buffer(dest);
+            dest->string = string;
+            dest->mem_size = new_mem_size;
+            dest->length = src_len;
+        }
+    } else if (dest) {
+        DS_drop_utf8_index(dest);
         size_t src_len = strlen(src);
-        size_t new_mem_size = max_long((src_len + 1), dest->mem_size);
+        size_t new_mem_size = max_size((src_len + 1), dest->mem_size);
         if (new_mem_size > dest->mem_size)
             dest = DS_realloc(dest, new_mem_size);
         if (dest) {
@@ -291,14 +1834,17 @@ dynamic_string *DS_set_text(dynamic_string *dest, char *src) {
     return dest;
 }
 
-dynamic_string *DS_init(char *str) {
-    dynamic_string *string = malloc(sizeof(dynamic_string));
+dynamic_string *DS_init_alloc(char *str, const lw_allocator *allocator) {
+    dynamic_string *string = lw_alloc(allocator, sizeof(dynamic_string), LW_MEM_STRING);
     if (string) {
+        string->allocator = allocator;
+        string->shared = NULL;
+        string->utf8_index = NULL;
         string->mem_size = 20;
-        string->string = malloc(string->mem_size);
+        string->string = lw_alloc(allocator, string->mem_size, LW_MEM_STRING);
         if (string->string == NULL) {
             fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
-            free(string);
+            lw_free(allocator, string);
             string = NULL;
         } else {
             if (str)
@@ -310,9 +1856,13 @@ dynamic_string *DS_init(char *str) {
     return string;
 }
 
+dynamic_string *DS_init(char *str) {
+    return DS_init_alloc(str, global_allocator);
+}
+
 dynamic_string *DS_insert_text(dynamic_string *dest, const char *src, const size_t pos) {
     size_t src_len = strlen(src);
-    if (dest && src_len) {
+    if (dest && src_len && pos <= dest->length && DS_detach(dest, src_len + dest->length + 1)) {
         size_t new_mem_size = src_len + dest->length + 1;
         if (new_mem_size > dest->mem_size)
             dest = DS_realloc(dest, new_mem_size);
@@ -323,7 +1873,7 @@ dynamic_string *DS_insert_text(dynamic_string *dest, const char *src, const size
         if (!src_len) {
             fprintf(stderr, "ERROR (dynamic_string):[%s][%zu] trying to insert string '%s'" \
             " that is empty.\n", dest->string, dest->length, src);
-        } else {
+        } else if (pos > dest->length) {
             fprintf(stderr, "ERROR (dynamic_string):[%s][%zu] trying to insert string '%s'" \
             " at position '%zu' that is out of bounds.\n", dest->string, dest->length, src, pos);
         }
@@ -336,7 +1886,7 @@ dynamic_string *DS_append_char(dynamic_string *dest, const char src) {
 }
 
 dynamic_string *DS_set_char(dynamic_string *dest, const char src, const size_t pos) {
-    if (dest) {
+    if (dest && DS_detach(dest, dest->mem_size + (pos == dest->length))) {
         // Trying to put char inside string
         if (pos < dest->length) {
             dest->string[pos] = src;
@@ -347,6 +1897,7 @@ dynamic_string *DS_set_char(dynamic_string *dest, const char src, const size_t p
             if (!(src == 0 && dest->string[pos] == 0)) {
                 dest->string[pos] = src;
                 dest->length++;
+                dest->string[dest->length] = 0;
             }
         // Trying to put char at end of the string and need to allocate more memory
         } else if (pos == dest->length && dest->length == dest->mem_size - 1) {
@@ -367,6 +1918,161 @@ dynamic_string *DS_set_char(dynamic_string *dest, const char src, const size_t p
 }
 
 
+size_t DS_find(const dynamic_string *ds, const char *needle, const size_t pos) {
+    if (ds == NULL || needle == NULL)
+        return DS_NPOS;
+    return find_substring(ds->string, ds->length, needle, strlen(needle), pos);
+}
+
+size_t DS_find_any(const dynamic_string *ds, const char *set, const size_t pos) {
+    if (ds == NULL || set == NULL)
+        return DS_NPOS;
+    byte_set bytes;
+    byte_set_init(&bytes, set);
+    return find_byte_set(ds->string, ds->length, &bytes, pos);
+}
+
+size_t DS_split(const dynamic_string *ds, const char *delims, bool skip_empty,
+                string_view *views, const size_t max_views) {
+    size_t count = 0;
+    if (ds && delims) {
+        byte_set set;
+        byte_set_init(&set, delims);
+        size_t start = 0;
+        bool done = false;
+        while (!done) {
+            size_t end = find_byte_set(ds->string, ds->length, &set, start);
+            if (end == DS_NPOS) {
+                end = ds->length;
+                done = true;
+            }
+            if (!(skip_empty && end == start)) {
+                if (count < max_views)
+                    views[count] = (string_view){ds->string + start, end - start};
+                count++;
+            }
+            start = end + 1;
+        }
+    }
+    return count;
+}
+
+dynamic_string *DS_replace_all(dynamic_string *dest, const char *pattern, const char *replacement) {
+    if (dest == NULL || pattern == NULL || replacement == NULL)
+        return dest;
+    const size_t pattern_len = strlen(pattern);
+    const size_t replacement_len = strlen(replacement);
+    if (pattern_len == 0) {
+        fprintf(stderr, "ERROR (dynamic_string):[%s][%zu] trying to replace empty pattern.\n",
+                dest->string, dest->length);
+        return dest;
+    }
+    size_t pos = DS_find(dest, pattern, 0);
+    const bool grows = replacement_len > pattern_len;
+    if (pos == DS_NPOS || (!grows && !DS_detach(dest, dest->mem_size)))
+        return dest;
+    const char *src = dest->string;
+    const char *end = dest->string + dest->length;
+    char *out = dest->string;
+    size_t capacity = dest->mem_size;
+    if (grows) {
+        // result is longer so writing in place would overrun unread text, buffer grows as matches are found
+        capacity = max_size(dest->mem_size, dest->length + 4 * (replacement_len - pattern_len) + 1);
+        out = lw_alloc(DS_allocator(dest), capacity, LW_MEM_STRING);
+        if (out == NULL) {
+            fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
+            return dest;
+        }
+    }
+    size_t length = 0;
+    while (pos != DS_NPOS) {
+        // room for the rest of the text if there are no more matches
+        const size_t needed = length + pos + replacement_len + (end - src - pos - pattern_len) + 1;
+        if (grows && needed > capacity) {
+            capacity = max_size(needed, capacity * 2);
+            char *grown = lw_realloc(DS_allocator(dest), out, capacity, LW_MEM_STRING);
+            if (grown == NULL) {
+                fprintf(stderr, "ERROR (dynamic_string): Cant realloc.\n");
+                lw_free(DS_allocator(dest), out);
+                return dest;
+            }
+            out = grown;
+        }
+        memmove(out + length, src, pos);
+        length += pos;
+        memcpy(out + length, replacement, replacement_len);
+        length += replacement_len;
+        src += pos + pattern_len;
+        pos = find_substring(src, end - src, pattern, pattern_len, 0);
+    }
+    memmove(out + length, src, end - src);
+    length += end - src;
+    out[length] = 0;
+    if (grows) {
+        DS_drop_buffer(dest);
+        dest->mem_size = capacity;
+        dest->string = out;
+    }
+    dest->length = length;
+    return dest;
+}
+
+
+bool DS_validate_utf8(const dynamic_string *ds) {
+    return ds && utf8_validate(ds->string, ds->length);
+}
+
+size_t DS_utf8_length(const dynamic_string *ds) {
+    if (ds == NULL)
+        return 0;
+    return ds->utf8_index ? ds->utf8_index->length : utf8_length(ds->string, ds->length);
+}
+
+bool DS_utf8_index(dynamic_string *ds) {
+    if (ds == NULL)
+        return false;
+    if (ds->utf8_index)
+        return true;
+    const size_t length = utf8_length(ds->string, ds->length);
+    const size_t count = length / UTF8_INDEX_STRIDE + 1;
+    struct ds_utf8_index *index = lw_alloc(DS_allocator(ds), sizeof(*index) + count * sizeof(size_t),
+                                           LW_MEM_STRING);
+    if (index == NULL) {
+        fprintf(stderr, "ERROR (dynamic_string): Couldnt malloc.\n");
+        return false;
+    }
+    index->length = length;
+    size_t codepoint = 0;
+    for (size_t i = 0; i < ds->length; i++) {
+        if (((unsigned char)ds->string[i] & 0xC0) != 0x80) {
+            if (codepoint % UTF8_INDEX_STRIDE == 0)
+                index->offsets[codepoint / UTF8_INDEX_STRIDE] = i;
+            codepoint++;
+        }
+    }
+    ds->utf8_index = index;
+    return true;
+}
+
+size_t DS_utf8_offset(const dynamic_string *ds, const size_t index) {
+    if (ds == NULL)
+        return DS_NPOS;
+    size_t pos = 0;
+    size_t skip = index;
+    if (ds->utf8_index) {
+        if (index >= ds->utf8_index->length)
+            return index == ds->utf8_index->length ? ds->length : DS_NPOS;
+        pos = ds->utf8_index->offsets[index / UTF8_INDEX_STRIDE];
+        skip = index % UTF8_INDEX_STRIDE;
+    }
+    // walking over lead bytes, continuation bytes are skipped
+    for (; pos < ds->length; pos++) {
+        if (((unsigned char)ds->string[pos] & 0xC0) != 0x80 && skip-- == 0)
+            return pos;
+    }
+    return skip == 0 ? ds->length : DS_NPOS;
+}
+
 dynamic_string *multiply_string_by_digit(dynamic_string *result, const char *str1, const size_t len, \
                                 int digit, bool keep_reversed) {
     if (digit <= 9 && digit >= -9) {
@@ -400,7 +2106,7 @@ dynamic_string *multiply_string_by_digit(dynamic_string *result, const char *str
         errno = EINVAL;
     }
     if (!keep_reversed)
-        str_reverse(result->string);
+        DS_reverse(result);
 
     return result;
 }
@@ -411,17 +2117,20 @@ dynamic_string *sum_strings(dynamic_string *result, const char *str1, const size
         fprintf(stderr, "ERROR (sum_strings): offset cant be more than str1 lenght.\n");
         return result;
     }
-    char *buf1 = malloc(len1 + 1);
-    char *buf2 = malloc(len2 + 1);
+    char *buf1 = lw_alloc(global_allocator, len1 + 1, LW_MEM_NUMBER);
+    char *buf2 = lw_alloc(global_allocator, len2 + 1, LW_MEM_NUMBER);
     if (!buf1 || !buf2) {
         fprintf(stderr, "ERROR (sum_strings): error during malloc\n");
+        lw_free(global_allocator, buf1);
+        lw_free(global_allocator, buf2);
         return result;
     }
-    buf1 = strncpy(buf1, str1, len1 + 1);
-    buf2 = strncpy(buf2, str2, len2 + 1);
-    if (!using_reversed) {
-        str_reverse(buf1);
-        str_reverse(buf2);
+    if (using_reversed) {
+        buf1 = strncpy(buf1, str1, len1 + 1);
+        buf2 = strncpy(buf2, str2, len2 + 1);
+    } else {
+        buf1 = str_reverse_copy(buf1, str1, len1);
+        buf2 = str_reverse_copy(buf2, str2, len2);
     }
     size_t index = 0;
     int carryover = 0;
@@ -453,53 +2162,504 @@ dynamic_string *sum_strings(dynamic_string *result, const char *str1, const size
         index++;
     }
     result = DS_set_char(result, 0, index);
-    if (!using_reversed) {
-        str_reverse(result->string);
-    }
-    free(buf1);
-    free(buf2);
+    if (!using_reversed)
+        DS_reverse(result);
+    lw_free(global_allocator, buf1);
+    lw_free(global_allocator, buf2);
     return result;
 }
 
-dynamic_string **compute_multi_rows(dynamic_string **buffers, const char *str1, const size_t len1,
-                                 const char *str2, const size_t len2) {
-     // long multiplying and storing in reverse order
-    for (int i = len2 - 1; i >= 0; i--) {
-        int index_i = len2 - 1 - i;
-        buffers[index_i] = multiply_string_by_digit(buffers[index_i], str1, len1, str2[i] - '0', true);
+/*
+    Signed arithmetic works on magnitudes: digit strings without sign and leading zeros, "0" for zero.
+    Sign is applied to the result at the end.
+*/
+
+// divisors with at most this many digits are divided with 64 bit arithmetic
+#define SHORT_DIVISOR_DIGITS 18
+// reciprocals up to this precision are computed with short division
+#define RECIPROCAL_BASE_DIGITS 16
+/*
+    Newton division is used when both divisor and quotient have more digits than this. It costs about seven
+    multiplications, so it is faster than quadratic schoolbook division once both sides have few limbs
+    (measured: equal at 20 - 30 digits, 5 times faster at 200 / 200 digits and 100 times at 2000 / 2000).
+    This is the default of lw_set_newton_division_digits.
+*/
+#ifndef NEWTON_DIVISION_DIGITS
+#define NEWTON_DIVISION_DIGITS 30
+#endif
+static _Atomic size_t newton_division_digits = NEWTON_DIVISION_DIGITS;
+
+size_t lw_set_newton_division_digits(size_t digits) {
+    return atomic_exchange_explicit(&newton_division_digits, digits, memory_order_relaxed);
+}
+
+// parses optionally signed decimal, leading zeros are skipped
+static bool parse_signed(const char *str, bool *negative, const char **digits, size_t *len) {
+    if (str == NULL)
+        return false;
+    *negative = *str == '-';
+    if (*str == '-' || *str == '+')
+        str++;
+    size_t n = strspn(str, "0123456789");
+    if (n == 0 || str[n] != 0)
+        return false;
+    while (n > 1 && *str == '0') {
+        str++;
+        n--;
     }
-    return buffers;
+    *digits = str;
+    *len = n;
+    return true;
 }
 
-dynamic_string *sum_multi_rows(dynamic_string *result_str, dynamic_string **buffers, \
-                         const size_t buf_size) {
-    result_str = DS_set_text(result_str, buffers[0]->string);
-    for (size_t i = 1; i < buf_size; i++) {
-        sum_strings(result_str, result_str->string, result_str->length,
-                             buffers[i]->string, buffers[i]->length, i, true);
+static int magnitude_compare(const char *a, size_t alen, const char *b, size_t blen) {
+    if (alen != blen)
+        return alen < blen ? -1 : 1;
+    int cmp = memcmp(a, b, alen);
+    return (cmp > 0) - (cmp < 0);
+}
+
+// dest = a - b for a >= b, a can point into dest
+static dynamic_string *magnitude_subtract(dynamic_string *dest, const char *a, size_t alen,
+                                          const char *b, size_t blen) {
+    char *buffer = lw_alloc(global_allocator, alen + 1, LW_MEM_NUMBER);
+    if (buffer == NULL) {
+        fprintf(stderr, "ERROR (subtract_strings): error during malloc\n");
+        return dest;
+    }
+    int borrow = 0;
+    for (size_t i = 0; i < alen; i++) {
+        int d = a[alen - 1 - i] - '0' - borrow - (i < blen ? b[blen - 1 - i] - '0' : 0);
+        borrow = d < 0;
+        buffer[alen - 1 - i] = d + borrow * 10 + '0';
+    }
+    buffer[alen] = 0;
+    size_t skip = strspn(buffer, "0");
+    dest = DS_set_text(dest, buffer + (skip == alen ? alen - 1 : skip));
+    lw_free(global_allocator, buffer);
+    return dest;
+}
+
+// dest = a + b, a can point into dest
+static dynamic_string *magnitude_add(dynamic_string *dest, const char *a, size_t alen,
+                                     const char *b, size_t blen) {
+    return sum_strings(dest, a, alen, b, blen, 0, false);
+}
+
+// dest = a * 10^shift, a can point into dest
+static dynamic_string *magnitude_shift(dynamic_string *dest, const char *a, size_t alen, size_t shift) {
+    const bool in_place = a == dest->string;
+    dest = DS_realloc(dest, max_size(dest->mem_size, alen + shift + 1));
+    if (in_place)
+        a = dest->string;
+    memmove(dest->string, a, alen);
+    bool zero = alen == 1 && a[0] == '0';
+    memset(dest->string + alen, '0', zero ? 0 : shift);
+    dest->length = alen + (zero ? 0 : shift);
+    dest->string[dest->length] = 0;
+    return dest;
+}
+
+// dest = a / 10^shift
+static dynamic_string *magnitude_truncate(dynamic_string *dest, size_t shift) {
+    if (dest->length <= shift)
+        return DS_set_text(dest, "0");
+    return DS_set_char(dest, 0, dest->length - shift);
+}
+
+/*
+    Multiplication works on limbs of 9 decimal digits (least significant limb first), so one limb product
+    with carries fits into 64 bits. Long operands are multiplied with Karatsuba: a = a1 * B^m + a0,
+    b = b1 * B^m + b0 and a * b = z2 * B^2m + z1 * B^m + z0, where z1 = (a0 + a1)(b0 + b1) - z0 - z2 takes
+    one multiplication instead of two.
+*/
+#define LIMB_DIGITS 9
+#define LIMB_BASE 1000000000U
+// operands with fewer limbs are multiplied by schoolbook method
+#define KARATSUBA_LIMBS 32
+
+// r += b, r must have room for carry
+static void limbs_add(uint32_t *r, size_t rn, const uint32_t *b, size_t bn) {
+    uint32_t carry = 0;
+    for (size_t i = 0; i < rn && (i < bn || carry); i++) {
+        uint32_t d = r[i] + (i < bn ? b[i] : 0) + carry;
+        carry = d >= LIMB_BASE;
+        r[i] = d - carry * LIMB_BASE;
     }
-    return result_str;
+}
+
+// r -= b for r >= b
+static void limbs_subtract(uint32_t *r, size_t rn, const uint32_t *b, size_t bn) {
+    uint32_t borrow = 0;
+    for (size_t i = 0; i < rn && (i < bn || borrow); i++) {
+        uint32_t d = (i < bn ? b[i] : 0) + borrow;
+        borrow = r[i] < d;
+        r[i] = r[i] + borrow * LIMB_BASE - d;
+    }
+}
+
+// r = a * b, r has an + bn zeroed limbs
+static void limbs_multiply_schoolbook(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b,
+                                      size_t bn) {
+    for (size_t i = 0; i < an; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < bn; j++) {
+            uint64_t t = r[i + j] + (uint64_t)a[i] * b[j] + carry;
+            r[i + j] = t % LIMB_BASE;
+            carry = t / LIMB_BASE;
+        }
+        r[i + bn] = carry;
+    }
+}
+
+// r = a * b, r has an + bn zeroed limbs
+static bool limbs_multiply(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+    if (an < bn)
+        return limbs_multiply(r, b, bn, a, an);
+    if (bn < KARATSUBA_LIMBS) {
+        limbs_multiply_schoolbook(r, a, an, b, bn);
+        return true;
+    }
+    if (an >= 2 * bn) {
+        // unbalanced operands: a is multiplied by b in slices of bn limbs
+        uint32_t *slice = lw_alloc(global_allocator, 2 * bn * sizeof(uint32_t), LW_MEM_NUMBER);
+        bool ok = slice != NULL;
+        for (size_t offset = 0; ok && offset < an; offset += bn) {
+            size_t n = min_size(bn, an - offset);
+            memset(slice, 0, (n + bn) * sizeof(uint32_t));
+            ok = limbs_multiply(slice, a + offset, n, b, bn);
+            limbs_add(r + offset, an + bn - offset, slice, n + bn);
+        }
+        lw_free(global_allocator, slice);
+        return ok;
+    }
+    // high parts have at most m limbs, so sums of halves fit into m + 1 limbs
+    const size_t m = (an + 1) / 2;
+    uint32_t *sums = lw_alloc(global_allocator, (4 * m + 4) * sizeof(uint32_t), LW_MEM_NUMBER);
+    if (sums == NULL)
+        return false;
+    uint32_t *sa = sums;
+    uint32_t *sb = sums + m + 1;
+    uint32_t *z1 = sums + 2 * m + 2;
+    memset(sums, 0, (4 * m + 4) * sizeof(uint32_t));
+    memcpy(sa, a, m * sizeof(uint32_t));
+    limbs_add(sa, m + 1, a + m, an - m);
+    memcpy(sb, b, m * sizeof(uint32_t));
+    limbs_add(sb, m + 1, b + m, bn - m);
+    bool ok = limbs_multiply(r, a, m, b, m) && limbs_multiply(r + 2 * m, a + m, an - m, b + m, bn - m) &&
+              limbs_multiply(z1, sa, m + 1, sb, m + 1);
+    if (ok) {
+        limbs_subtract(z1, 2 * m + 2, r, 2 * m);
+        limbs_subtract(z1, 2 * m + 2, r + 2 * m, an + bn - 2 * m);
+        limbs_add(r + m, an + bn - m, z1, 2 * m + 2);
+    }
+    lw_free(global_allocator, sums);
+    return ok;
+}
+
+static void digits_to_limbs(uint32_t *limbs, const char *digits, size_t len) {
+    for (size_t i = 0; i * LIMB_DIGITS < len; i++) {
+        size_t end = len - i * LIMB_DIGITS;
+        size_t start = end > LIMB_DIGITS ? end - LIMB_DIGITS : 0;
+        uint32_t limb = 0;
+        for (size_t j = start; j < end; j++)
+            limb = limb * 10 + (digits[j] - '0');
+        limbs[i] = limb;
+    }
+}
+
+// dest = a * b, a and b can point into dest
+static dynamic_string *magnitude_multiply(dynamic_string *dest, const char *a, size_t alen,
+                                          const char *b, size_t blen) {
+    const size_t an = (alen + LIMB_DIGITS - 1) / LIMB_DIGITS;
+    const size_t bn = (blen + LIMB_DIGITS - 1) / LIMB_DIGITS;
+    const size_t digits = (an + bn) * LIMB_DIGITS;
+    uint32_t *limbs = lw_alloc(global_allocator, 2 * (an + bn) * sizeof(uint32_t), LW_MEM_NUMBER);
+    char *buffer = lw_alloc(global_allocator, digits + 1, LW_MEM_NUMBER);
+    if (limbs == NULL || buffer == NULL) {
+        fprintf(stderr, "ERROR (multiply_strings): error during malloc\n");
+        lw_free(global_allocator, limbs);
+        lw_free(global_allocator, buffer);
+        return dest;
+    }
+    uint32_t *product = limbs + an + bn;
+    digits_to_limbs(limbs, a, alen);
+    digits_to_limbs(limbs + an, b, blen);
+    memset(product, 0, (an + bn) * sizeof(uint32_t));
+    if (limbs_multiply(product, limbs, an, limbs + an, bn)) {
+        for (size_t i = 0; i < an + bn; i++) {
+            uint32_t limb = product[i];
+            for (size_t j = 0; j < LIMB_DIGITS; j++) {
+                buffer[digits - 1 - i * LIMB_DIGITS - j] = limb % 10 + '0';
+                limb /= 10;
+            }
+        }
+        buffer[digits] = 0;
+        size_t skip = strspn(buffer, "0");
+        dest = DS_set_text(dest, buffer + (skip == digits ? digits - 1 : skip));
+    } else {
+        fprintf(stderr, "ERROR (multiply_strings): error during malloc\n");
+    }
+    lw_free(global_allocator, limbs);
+    lw_free(global_allocator, buffer);
+    return dest;
+}
+
+// quotient and remainder of division by divisor < 10^18, digit by digit in one pass
+static void divide_short(dynamic_string *quotient, dynamic_string *remainder, const char *a, size_t alen,
+                         uint64_t divisor) {
+    char *buffer = lw_alloc(global_allocator, alen + 1, LW_MEM_NUMBER);
+    if (buffer == NULL) {
+        fprintf(stderr, "ERROR (divide_strings): error during malloc\n");
+        return;
+    }
+    uint64_t rest = 0;
+    for (size_t i = 0; i < alen; i++) {
+        rest = rest * 10 + (a[i] - '0');
+        buffer[i] = rest / divisor + '0';
+        rest %= divisor;
+    }
+    buffer[alen] = 0;
+    size_t skip = strspn(buffer, "0");
+    if (quotient)
+        DS_set_text(quotient, buffer + (skip == alen ? alen - 1 : skip));
+    if (remainder) {
+        snprintf(buffer, alen + 1, "%llu", (unsigned long long)rest);
+        DS_set_text(remainder, buffer);
+    }
+    lw_free(global_allocator, buffer);
+}
+
+static uint64_t leading_digits(const char *str, size_t len, size_t digits) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < digits; i++)
+        value = value * 10 + (i < len ? str[i] - '0' : 0);
+    return value;
+}
+
+/*
+    Schoolbook long division for divisor longer than 18 digits. Remainder window of blen + 1 digits is
+    shifted left one dividend digit at the time, quotient digit is estimated from leading 18 digits of the
+    window and 17 digits of divisor (estimate is never too big and at most few units too small), then
+    window -= digit * b in one pass and few more subtractions of b fix the estimate.
+*/
+static void divide_schoolbook(dynamic_string *quotient, dynamic_string *remainder, const char *a, size_t alen,
+                              const char *b, size_t blen) {
+    const size_t width = blen + 1;
+    char *window = lw_alloc(global_allocator, width + 1, LW_MEM_NUMBER);
+    char *buffer = lw_alloc(global_allocator, alen + 1, LW_MEM_NUMBER);
+    if (window == NULL || buffer == NULL) {
+        fprintf(stderr, "ERROR (divide_strings): error during malloc\n");
+        lw_free(global_allocator, window);
+        lw_free(global_allocator, buffer);
+        return;
+    }
+    const uint64_t b_top = leading_digits(b, blen, SHORT_DIVISOR_DIGITS - 1) + 1;
+    memset(window, '0', width);
+    window[width] = 0;
+    for (size_t i = 0; i < alen; i++) {
+        memmove(window, window + 1, width - 1);
+        window[width - 1] = a[i];
+        int digit = leading_digits(window, width, SHORT_DIVISOR_DIGITS) / b_top;
+        if (digit) {
+            int carry = 0;
+            for (size_t j = 0; j < width; j++) {
+                int product = (j < blen ? b[blen - 1 - j] - '0' : 0) * digit + carry;
+                int d = window[width - 1 - j] - '0' - product % 10;
+                carry = product / 10 + (d < 0);
+                window[width - 1 - j] = d + (d < 0) * 10 + '0';
+            }
+        }
+        while (window[0] != '0' || memcmp(window + 1, b, blen) >= 0) {
+            int borrow = 0;
+            for (size_t j = 0; j < width; j++) {
+                int d = window[width - 1 - j] - '0' - borrow - (j < blen ? b[blen - 1 - j] - '0' : 0);
+                borrow = d < 0;
+                window[width - 1 - j] = d + borrow * 10 + '0';
+            }
+            digit++;
+        }
+        buffer[i] = digit + '0';
+    }
+    buffer[alen] = 0;
+    size_t skip = strspn(buffer, "0");
+    if (quotient)
+        DS_set_text(quotient, buffer + (skip == alen ? alen - 1 : skip));
+    skip = strspn(window, "0");
+    if (remainder)
+        DS_set_text(remainder, window + (skip == width ? width - 1 : skip));
+    lw_free(global_allocator, window);
+    lw_free(global_allocator, buffer);
+}
+
+/*
+    Approximates 10^(2p) / B_p where B_p is top p digits of b (padded with zeros if b is shorter).
+    Newton iteration x' = x + x * (10^(2p) - B_p * x) / 10^(2p) doubles amount of correct digits, so
+    reciprocal of half precision is computed recursively and refined once. Every level works with
+    numbers of its own precision, so total cost is few multiplications of full size.
+*/
+static dynamic_string *reciprocal(dynamic_string *x, const char *b, size_t blen, size_t p) {
+    if (p <= RECIPROCAL_BASE_DIGITS) {
+        char one[2 * RECIPROCAL_BASE_DIGITS + 2] = "1";
+        memset(one + 1, '0', 2 * p);
+        one[2 * p + 1] = 0;
+        divide_short(x, NULL, one, 2 * p + 1, leading_digits(b, blen, p));
+        return x;
+    }
+    const size_t h = p / 2 + 2;
+    dynamic_string *b_p = DS_init(NULL);
+    dynamic_string *product = DS_init(NULL);
+    dynamic_string *error = DS_init(NULL);
+    dynamic_string *one = DS_init(NULL);
+    x = reciprocal(x, b, blen, h);
+    x = magnitude_shift(x, x->string, x->length, p - h);
+    if (blen >= p) {
+        b_p = magnitude_shift(b_p, b, p, 0);
+    } else {
+        b_p = magnitude_shift(b_p, b, blen, p - blen);
+    }
+    one = magnitude_shift(one, "1", 1, 2 * p);
+    product = magnitude_multiply(product, b_p->string, b_p->length, x->string, x->length);
+    bool too_big = magnitude_compare(product->string, product->length, one->string, one->length) > 0;
+    if (too_big)
+        error = magnitude_subtract(error, product->string, product->length, one->string, one->length);
+    else
+        error = magnitude_subtract(error, one->string, one->length, product->string, product->length);
+    product = magnitude_multiply(product, x->string, x->length, error->string, error->length);
+    product = magnitude_truncate(product, 2 * p);
+    if (too_big)
+        x = magnitude_subtract(x, x->string, x->length, product->string, product->length);
+    else
+        x = magnitude_add(x, x->string, x->length, product->string, product->length);
+    DS_free(b_p);
+    DS_free(product);
+    DS_free(error);
+    DS_free(one);
+    return x;
+}
+
+/*
+    Division by multiplication with reciprocal X ~ 10^(p + blen) / b, where p covers amount of quotient
+    digits, so quotient estimate a * X / 10^(p + blen) is off by few units that are fixed by comparing
+    estimate * b with a.
+*/
+static void divide_newton(dynamic_string *quotient, dynamic_string *remainder, const char *a, size_t alen,
+                          const char *b, size_t blen) {
+    const size_t p = max_size(blen, alen - blen) + 2;
+    dynamic_string *x = reciprocal(DS_init(NULL), b, blen, p);
+    dynamic_string *q = DS_init(NULL);
+    dynamic_string *product = DS_init(NULL);
+    dynamic_string *rest = DS_init(NULL);
+    q = magnitude_multiply(q, a, alen, x->string, x->length);
+    q = magnitude_truncate(q, p + blen);
+    product = magnitude_multiply(product, q->string, q->length, b, blen);
+    while (magnitude_compare(product->string, product->length, a, alen) > 0) {
+        q = magnitude_subtract(q, q->string, q->length, "1", 1);
+        product = magnitude_subtract(product, product->string, product->length, b, blen);
+    }
+    rest = magnitude_subtract(rest, a, alen, product->string, product->length);
+    while (magnitude_compare(rest->string, rest->length, b, blen) >= 0) {
+        q = magnitude_add(q, q->string, q->length, "1", 1);
+        rest = magnitude_subtract(rest, rest->string, rest->length, b, blen);
+    }
+    if (quotient)
+        DS_set_text(quotient, q->string);
+    if (remainder)
+        DS_set_text(remainder, rest->string);
+    DS_free(x);
+    DS_free(q);
+    DS_free(product);
+    DS_free(rest);
+}
+
+// puts sign in front of non zero magnitude
+static dynamic_string *apply_sign(dynamic_string *dest, bool negative) {
+    if (negative && !(dest->length == 1 && dest->string[0] == '0'))
+        dest = DS_insert_text(dest, "-", 0);
+    return dest;
 }
 
 dynamic_string *multiply_strings(dynamic_string *result_str, const char *str1, const char *str2) {
-    if (!result_str || !is_number(str1) || !is_number(str2))
+    bool negative1, negative2;
+    const char *a, *b;
+    size_t alen, blen;
+    if (!result_str || !parse_signed(str1, &negative1, &a, &alen) ||
+        !parse_signed(str2, &negative2, &b, &blen))
         return result_str;
-    size_t len1 = strlen(str1);
-    size_t len2 = strlen(str2);
-    dynamic_string **buffers = calloc(len2, sizeof(dynamic_string*));
-    for (size_t i = 0; i < len2; i++)
-        buffers[i] = DS_init(NULL);
-    buffers = compute_multi_rows(buffers, str1, len1, str2, len2);
-    result_str = sum_multi_rows(result_str, buffers, len2);
-
-    if (result_str->string[0] == '0')
-        DS_set_text(result_str, "0");
-    else
-        str_reverse(result_str->string);
-    for (size_t i = 0; i < len2; i++)
-        DS_free(buffers[i]);
-    free(buffers);
-    return result_str;
+    result_str = magnitude_multiply(result_str, a, alen, b, blen);
+    return apply_sign(result_str, negative1 != negative2);
+}
+
+dynamic_string *subtract_strings(dynamic_string *result, const char *str1, const char *str2) {
+    bool negative1, negative2;
+    const char *a, *b;
+    size_t alen, blen;
+    if (!result || !parse_signed(str1, &negative1, &a, &alen) || !parse_signed(str2, &negative2, &b, &blen)) {
+        fprintf(stderr, "ERROR (subtract_strings): arguments must be integers\n");
+        errno = EINVAL;
+        return result;
+    }
+    // a - b is a + (-b)
+    negative2 = !negative2;
+    if (negative1 == negative2) {
+        result = magnitude_add(result, a, alen, b, blen);
+    } else if (magnitude_compare(a, alen, b, blen) >= 0) {
+        result = magnitude_subtract(result, a, alen, b, blen);
+    } else {
+        result = magnitude_subtract(result, b, blen, a, alen);
+        negative1 = negative2;
+    }
+    return apply_sign(result, negative1);
+}
+
+bool divide_strings(dynamic_string *quotient, dynamic_string *remainder, const char *dividend,
+                    const char *divisor) {
+    bool negative1, negative2;
+    const char *a, *b;
+    size_t alen, blen;
+    if (!parse_signed(dividend, &negative1, &a, &alen) || !parse_signed(divisor, &negative2, &b, &blen)) {
+        fprintf(stderr, "ERROR (divide_strings): arguments must be integers\n");
+        errno = EINVAL;
+        return false;
+    }
+    if (blen == 1 && b[0] == '0') {
+        fprintf(stderr, "ERROR (divide_strings): division by zero\n");
+        errno = EDOM;
+        return false;
+    }
+    if (magnitude_compare(a, alen, b, blen) < 0) {
+        // dividend can point into quotient or remainder, so it is copied before they are written
+        char *rest = lw_alloc(global_allocator, alen + 1, LW_MEM_NUMBER);
+        if (rest == NULL) {
+            fprintf(stderr, "ERROR (divide_strings): error during malloc\n");
+            return false;
+        }
+        memcpy(rest, a, alen + 1);
+        if (quotient)
+            DS_set_text(quotient, "0");
+        if (remainder)
+            DS_set_text(remainder, rest);
+        lw_free(global_allocator, rest);
+    } else if (blen <= SHORT_DIVISOR_DIGITS) {
+        divide_short(quotient, remainder, a, alen, leading_digits(b, blen, blen));
+    } else if (blen <= atomic_load_explicit(&newton_division_digits, memory_order_relaxed) ||
+               alen - blen + 1 <= atomic_load_explicit(&newton_division_digits, memory_order_relaxed)) {
+        divide_schoolbook(quotient, remainder, a, alen, b, blen);
+    } else {
+        divide_newton(quotient, remainder, a, alen, b, blen);
+    }
+    // truncating division: quotient is negative if signs differ, remainder has sign of dividend
+    if (quotient)
+        apply_sign(quotient, negative1 != negative2);
+    if (remainder)
+        apply_sign(remainder, negative1);
+    return true;
+}
+
+dynamic_string *modulo_strings(dynamic_string *result, const char *dividend, const char *divisor) {
+    if (result)
+        divide_strings(NULL, result, dividend, divisor);
+    return result;
 }
 
 double get_random_double(unsigned int *seed, unsigned long min, unsigned long max,
@@ -3,6 +3,8 @@
 #ifndef SRC_LW_UTILS_H_
 #define SRC_LW_UTILS_H_
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #if defined(__linux__)
 #include <sys/types.h>
@@ -30,6 +32,146 @@ int rand_r(unsigned int *seed);
 typedef intptr_t ssize_t;
 #endif
 
+/**
+    @brief Parts of the library that allocate memory, passed to allocator for statistics
+*/
+typedef enum {
+    LW_MEM_LIST,  /**< list nodes and lines loaded by list_add_from_file*/
+    LW_MEM_STRING,  /**< dynamic_string structures and their buffers*/
+    LW_MEM_NUMBER,  /**< temporary buffers of numeric string arithmetic*/
+    LW_MEM_OTHER,  /**< everything else*/
+    LW_MEM_SUBSYSTEMS  /**< amount of subsystems, not a subsystem*/
+} lw_mem_subsystem;
+
+/**
+    @brief Allocator used by the library instead of malloc/realloc/free
+*/
+typedef struct {
+    void *(*alloc)(void *context, size_t size, lw_mem_subsystem subsystem);  /**< works like malloc*/
+    void *(*realloc)(void *context, void *ptr, size_t size, lw_mem_subsystem subsystem);  /**< like realloc*/
+    void (*free)(void *context, void *ptr);  /**< works like free, never gets NULL*/
+    void *context;  /**< passed as first argument to every function*/
+} lw_allocator;
+
+/**
+    @brief Allocation statistics of lw_counting_allocator
+*/
+typedef struct {
+    size_t allocations;  /**< amount of alloc and realloc calls*/
+    size_t frees;  /**< amount of free calls*/
+    size_t bytes;  /**< total requested bytes*/
+    size_t current;  /**< bytes that are currently in use*/
+    size_t peak;  /**< maximum of current*/
+} lw_mem_stats;
+
+/**
+    @brief Allocator that counts allocations of every subsystem and passes them to another allocator
+*/
+typedef struct lw_counting_allocator lw_counting_allocator;
+
+/**
+    @brief Gets allocator that is used by functions without allocator parameter
+
+    @return const lw_allocator* : current global allocator (malloc based by default)
+*/
+const lw_allocator *lw_get_allocator(void);
+
+/**
+    @brief Sets allocator that is used by functions without allocator parameter (not thread safe, memory
+    allocated before the call must still be free'd with allocator that allocated it)
+
+    @param allocator allocator that must outlive its usage, if NULL restores malloc based allocator
+*/
+void lw_set_allocator(const lw_allocator *allocator);
+
+/**
+    @brief Creates thread safe allocator that collects statistics for every lw_mem_subsystem
+
+    @param parent allocator that will do actual allocations, if NULL uses malloc
+    @return lw_counting_allocator* : new counting allocator or NULL
+*/
+lw_counting_allocator *lw_counting_allocator_create(const lw_allocator *parent);
+
+/**
+    @brief Gets allocator interface of counting allocator that can be passed to library functions
+
+    @param counter counting allocator
+    @return const lw_allocator* : allocator interface
+*/
+const lw_allocator *lw_counting_allocator_get(lw_counting_allocator *counter);
+
+/**
+    @brief Gets allocation statistics
+
+    @param counter counting allocator
+    @param subsystem subsystem to get statistics for, LW_MEM_SUBSYSTEMS sums all of them
+    @return lw_mem_stats : statistics
+*/
+lw_mem_stats lw_counting_allocator_stats(lw_counting_allocator *counter, lw_mem_subsystem subsystem);
+
+/**
+    @brief Resets statistics (memory that is still in use stays counted)
+
+    @param counter counting allocator
+*/
+void lw_counting_allocator_reset(lw_counting_allocator *counter);
+
+/**
+    @brief Destroys counting allocator, memory allocated by it must be free'd before
+
+    @param counter counting allocator
+*/
+void lw_counting_allocator_destroy(lw_counting_allocator *counter);
+
+/**
+    @brief Table that stores one copy of every distinct string in append only arena (not thread safe)
+*/
+typedef struct lw_intern_table lw_intern_table;
+
+/**
+    @brief Deduplication statistics of intern table
+*/
+typedef struct {
+    size_t unique;  /**< amount of distinct strings stored*/
+    size_t total;  /**< amount of lw_intern calls*/
+    size_t bytes;  /**< bytes of strings stored in arena, including terminating zeros*/
+    size_t bytes_saved;  /**< bytes that were not copied because string was already interned*/
+    double dedup_ratio;  /**< total / unique*/
+} lw_intern_stats;
+
+/**
+    @brief Creates intern table
+
+    @param allocator allocator for table and its arena, if NULL uses global one
+    @return lw_intern_table* : new table or NULL
+*/
+lw_intern_table *lw_intern_table_create(const lw_allocator *allocator);
+
+/**
+    @brief Interns string, equal strings get the same pointer so they can be compared with ==
+
+    @param table intern table
+    @param str string to intern, does not have to be zero terminated
+    @param len length of str
+    @return const char* : zero terminated copy that stays valid until table is destroyed or NULL
+*/
+const char *lw_intern(lw_intern_table *table, const char *str, size_t len);
+
+/**
+    @brief Gets deduplication statistics
+
+    @param table intern table
+    @return lw_intern_stats : statistics
+*/
+lw_intern_stats lw_intern_table_stats(const lw_intern_table *table);
+
+/**
+    @brief Destroys intern table, all interned strings are free'd with it
+
+    @param table intern table
+*/
+void lw_intern_table_destroy(lw_intern_table *table);
+
 /**
     @brief Structure for holding dynamic string
 */
@@ -37,8 +179,32 @@ typedef struct {
     char *string;  /**< raw string, !DO NOT MODIFY DIRECTLY!*/
     size_t mem_size;  /**< size of the string array*/
     size_t length;  /**< length of the string without terminating zero*/
+    const lw_allocator *allocator;  /**< allocator of the string, NULL means malloc*/
+    struct ds_shared *shared;  /**< reference counter when buffer is shared with DS_share, NULL if owned*/
+    struct ds_utf8_index *utf8_index;  /**< code point index built by DS_utf8_index, NULL if not built*/
 } dynamic_string;
 
+/// @brief Returned by search functions when nothing was found
+#define DS_NPOS SIZE_MAX
+
+/**
+    @brief Non owning view into part of a string, not zero terminated
+*/
+typedef struct {
+    const char *data;  /**< start of the view*/
+    size_t length;  /**< amount of chars in the view*/
+} string_view;
+
+
+/**
+    @brief Options of list_add_from_file_opts
+*/
+typedef struct {
+    const lw_allocator *allocator;  /**< allocator for nodes and lines, NULL means global one*/
+    bool validate_utf8;  /**< if true then loading stops with EILSEQ at first line that is not valid UTF-8*/
+    lw_intern_table *intern;  /**< if set then lines are interned and nodes are added as not owning them*/
+    size_t error_line;  /**< set by loader: number of invalid line counting from 1, zero if there is none*/
+} list_load_options;
 
 /**
     @brief Structure for node in liked list
@@ -47,6 +213,8 @@ typedef struct list {
     void *data;
     bool is_dynamic;
     struct list *next_node;
+    const lw_allocator *allocator;  /**< allocator that made the node and frees it*/
+    const lw_allocator *data_allocator;  /**< allocator that frees data if it is dynamic*/
 } list;
 
 /**
@@ -54,10 +222,20 @@ typedef struct list {
 
     @param first_node pointer to a first element of param list to add to, if NULL creates new list
     @param flag data to put
-    @param is_dynamic if true then on list_free() data will be free'd
+    @param is_dynamic if true then on list_free() data will be free'd with free()
     @return list : pointer to first element in list
 */
 list *list_add(list **first_node, void *data, bool is_dynamic);
+/**
+    @brief Creates or adds to linkied list containing data using given allocator
+
+    @param first_node pointer to a first element of param list to add to, if NULL creates new list
+    @param flag data to put
+    @param is_dynamic if true then on list_free() data will be free'd with allocator
+    @param allocator allocator for nodes and for dynamic data, it is remembered by every node
+    @return list : pointer to first element in list
+*/
+list *list_add_alloc(list **first_node, void *data, bool is_dynamic, const lw_allocator *allocator);
 /**
     @brief Creates or adds to linked list form a file one line at the time
 
@@ -67,7 +245,25 @@ list *list_add(list **first_node, void *data, bool is_dynamic);
 */
 int list_add_from_file(list **first_node, char *filename);
 /**
-    @brief Removes last element in linked list
+    @brief Creates or adds to linked list form a file one line at the time using given allocator
+
+    @param first_node pointer to a first element of param list to add to, if NULL creates new list
+    @param filename path to filename
+    @param allocator allocator for nodes and lines
+    @return int : zero if success or error code
+*/
+int list_add_from_file_alloc(list **first_node, char *filename, const lw_allocator *allocator);
+/**
+    @brief Creates or adds to linked list form a file one line at the time, lines are checked while they are read
+
+    @param first_node pointer to a first element of param list to add to, if NULL creates new list
+    @param filename path to filename
+    @param options loading options, NULL means defaults
+    @return int : zero if success or error code, EILSEQ if line is not valid UTF-8
+*/
+int list_add_from_file_opts(list **first_node, char *filename, list_load_options *options);
+/**
+    @brief Removes last element in linked list, node and its data are free'd with allocators they were added with
 
     @param first_node: pointer to a first element of param list
 */
@@ -93,6 +289,181 @@ list *list_get_last(const list *first_node);
 */
 size_t list_get_length(const list *first_node);
 
+/**
+    @brief Link that is embedded into user structure to put it into intrusive list
+*/
+typedef struct ilist_link {
+    struct ilist_link *prev;
+    struct ilist_link *next;
+} ilist_link;
+
+/**
+    @brief Intrusive doubly linked list, does not allocate or free anything
+*/
+typedef struct {
+    ilist_link *head;  /**< first link or NULL*/
+    ilist_link *tail;  /**< last link or NULL*/
+    size_t length;  /**< amount of links in list*/
+} ilist;
+
+/// @brief Gets pointer to structure of `type` from pointer to its `member`
+#define LW_CONTAINER_OF(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+/// @brief Iterates over links of intrusive list (current link must not be removed inside the loop)
+#define ILIST_FOREACH(link, lst) for (ilist_link *link = (lst)->head; link; link = link->next)
+
+/**
+    @brief Initializes empty intrusive list
+
+    @param lst list to initialize
+*/
+void ilist_init(ilist *lst);
+
+/**
+    @brief Adds link at the end of intrusive list
+
+    @param lst list to add to
+    @param link link embedded into element, must not be in any list
+*/
+void ilist_add(ilist *lst, ilist_link *link);
+
+/**
+    @brief Adds link at the start of intrusive list
+
+    @param lst list to add to
+    @param link link embedded into element, must not be in any list
+*/
+void ilist_add_front(ilist *lst, ilist_link *link);
+
+/**
+    @brief Removes link from intrusive list
+
+    @param lst list that contains link
+    @param link link to remove
+*/
+void ilist_remove(ilist *lst, ilist_link *link);
+
+/**
+    @brief Removes last link in intrusive list
+
+    @param lst list to remove from
+    @return ilist_link* : removed link (element is not free'd) or NULL if list is empty
+*/
+ilist_link *ilist_pop(ilist *lst);
+
+/**
+    @brief Removes first link in intrusive list
+
+    @param lst list to remove from
+    @return ilist_link* : removed link (element is not free'd) or NULL if list is empty
+*/
+ilist_link *ilist_pop_front(ilist *lst);
+
+/**
+    @brief Gets the last link in intrusive list
+
+    @param lst list
+    @return ilist_link* : last link or NULL if list is empty
+*/
+inline ilist_link *ilist_get_last(const ilist *lst) {
+    return lst->tail;
+}
+
+/**
+    @brief Gets length of intrusive list
+
+    @param lst list
+    @return size_t : amount of links in list
+*/
+inline size_t ilist_get_length(const ilist *lst) {
+    return lst->length;
+}
+
+/**
+    @brief Bounded lock-free multi-producer/multi-consumer FIFO queue
+*/
+typedef struct lfqueue lfqueue;
+
+/**
+    @brief Bounded lock-free multi-producer/multi-consumer LIFO stack
+*/
+typedef struct lfstack lfstack;
+
+/**
+    @brief Creates lock-free queue, cells are allocated once so no memory is reclaimed while in use
+
+    @param capacity maximum amount of elements (rounded up to power of two)
+    @param allocator allocator for queue itself, if NULL uses global allocator
+    @return lfqueue* : new queue or NULL
+*/
+lfqueue *lfqueue_create(size_t capacity, const lw_allocator *allocator);
+
+/**
+    @brief Puts element at the end of the queue (thread safe)
+
+    @param queue queue to put element in
+    @param data data to put
+    @param is_dynamic if true then on lfqueue_free() data will be free'd with free(), owner of popped data
+    must free it
+    @return bool : false if queue is full
+*/
+bool lfqueue_push(lfqueue *queue, void *data, bool is_dynamic);
+
+/**
+    @brief Takes element from the front of the queue (thread safe)
+
+    @param queue queue to take element from
+    @param data where to put data, may be NULL
+    @param is_dynamic where to put is_dynamic flag of data, may be NULL
+    @return bool : false if queue is empty
+*/
+bool lfqueue_pop(lfqueue *queue, void **data, bool *is_dynamic);
+
+/**
+    @brief Frees queue and dynamic data that is still in it (must not be used concurrently)
+
+    @param queue queue to free
+*/
+void lfqueue_free(lfqueue *queue);
+
+/**
+    @brief Creates lock-free stack on preallocated pool of list nodes (nodes are reused and never
+    free'd while stack is in use, change counter in the head protects from ABA)
+
+    @param capacity maximum amount of elements
+    @param allocator allocator for stack itself, if NULL uses global allocator
+    @return lfstack* : new stack or NULL
+*/
+lfstack *lfstack_create(size_t capacity, const lw_allocator *allocator);
+
+/**
+    @brief Puts element on top of the stack (thread safe)
+
+    @param stack stack to put element on
+    @param data data to put
+    @param is_dynamic if true then on lfstack_free() data will be free'd with free(), owner of popped data
+    must free it
+    @return bool : false if stack is full
+*/
+bool lfstack_push(lfstack *stack, void *data, bool is_dynamic);
+
+/**
+    @brief Takes element from top of the stack (thread safe)
+
+    @param stack stack to take element from
+    @param data where to put data, may be NULL
+    @param is_dynamic where to put is_dynamic flag of data, may be NULL
+    @return bool : false if stack is empty
+*/
+bool lfstack_pop(lfstack *stack, void **data, bool *is_dynamic);
+
+/**
+    @brief Frees stack and dynamic data that is still in it (must not be used concurrently)
+
+    @param stack stack to free
+*/
+void lfstack_free(lfstack *stack);
+
 /**
     @brief Returns !dynamic string containing bit representation of passed variable
     
@@ -111,7 +482,29 @@ char *data_to_binary_string(const void *data, unsigned char bits);
 void print_binary(const void *data, unsigned char bits);
 
 /**
-    @brief Gets length of the list
+    @brief Pair of shell commands which outputs are compared
+*/
+typedef struct {
+    const char *command1;  /**< first command*/
+    const char *command2;  /**< second command*/
+} capp_pair;
+
+/**
+    @brief Result of comparing outputs of capp_pair
+*/
+typedef struct {
+    bool equal;  /**< true if outputs of both commands are byte for byte the same*/
+    bool failed;  /**< true if commands couldnt be started*/
+    size_t line;  /**< number of first mismatching line (starting from 1), zero if equal*/
+    char *line1;  /**< mismatching line of command1 output, NULL if output ended before it*/
+    char *line2;  /**< mismatching line of command2 output, NULL if output ended before it*/
+    size_t bytes;  /**< amount of bytes that matched*/
+    double seconds;  /**< time spent on running and comparing the pair*/
+} capp_result;
+
+/**
+    @brief Compares outputs of two commands line by line, so outputs that differ only by newline after the
+    last line are the same
 
     @param command1 first command which output we compare to second command
     @param command2 second command
@@ -120,6 +513,25 @@ void print_binary(const void *data, unsigned char bits);
 */
 bool capp_assert(char *command1, char *command2, bool suppress_msg);
 
+/**
+    @brief Compares outputs of many command pairs concurrently (outputs are compared byte for byte in
+    blocks, lines are extracted only for the first mismatch)
+
+    @param pairs array of command pairs
+    @param count amount of pairs
+    @param workers amount of threads to use, if zero uses amount of online cpus
+    @return capp_result* : !dynamic array of count results in order of pairs (free with capp_results_free)
+*/
+capp_result *capp_assert_batch(const capp_pair *pairs, size_t count, size_t workers);
+
+/**
+    @brief Frees results returned by capp_assert_batch
+
+    @param results array of results
+    @param count amount of results
+*/
+void capp_results_free(capp_result *results, size_t count);
+
 /**
     @brief Returns the maximum of given numbers
 
@@ -127,7 +539,9 @@ bool capp_assert(char *command1, char *command2, bool suppress_msg);
     @param b second number to compare
     @return long : The largest number from numbers passed as args
 */
-long max_long(long a, long b);
+inline long max_long(long a, long b) {
+    return a > b ? a : b;
+}
 
 /**
     @brief Returns the minimum of given numbers
@@ -136,7 +550,9 @@ long max_long(long a, long b);
     @param b second number to compare
     @return long : smallest number from numbers passed as args
 */
-long min_long(long a, long b);
+inline long min_long(long a, long b) {
+    return a < b ? a : b;
+}
 /**
     @brief Clamps the number in given limits
 
@@ -145,7 +561,135 @@ long min_long(long a, long b);
     @param max maximum limit
     @return long : Clamped number
 */
-long clamp_long(long d, long min, long max);
+inline long clamp_long(long d, long min, long max) {
+    const long t = d < min ? min : d;
+    return t > max ? max : t;
+}
+
+/**
+    @brief Returns the maximum of given sizes
+
+    @param a first size to compare
+    @param b second size to compare
+    @return size_t : The largest size from sizes passed as args
+*/
+inline size_t max_size(size_t a, size_t b) {
+    return a > b ? a : b;
+}
+
+/**
+    @brief Returns the minimum of given sizes
+
+    @param a first size to compare
+    @param b second size to compare
+    @return size_t : smallest size from sizes passed as args
+*/
+inline size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+/**
+    @brief Instruction sets used by array kernels
+*/
+typedef enum {
+    LW_SIMD_SCALAR,  /**< portable C*/
+    LW_SIMD_SSE4,  /**< SSE4.2 and POPCNT*/
+    LW_SIMD_AVX2  /**< AVX2 and POPCNT*/
+} lw_simd_level;
+
+/**
+    @brief Gets instruction set used by array kernels (detected on first call)
+
+    @return lw_simd_level : best supported instruction set unless changed by lw_set_simd_level
+*/
+lw_simd_level lw_get_simd_level(void);
+
+/**
+    @brief Limits instruction set used by array kernels (for testing and comparison)
+
+    @param level wanted instruction set
+    @return lw_simd_level : level that is actually used (wanted one or best supported if it is lower)
+*/
+lw_simd_level lw_set_simd_level(lw_simd_level level);
+
+/**
+    @brief Clamps every number of array in given limits
+
+    @param arr array that is clamped in place
+    @param n amount of numbers
+    @param min minimum limit
+    @param max maximum limit
+*/
+void clamp_long_array(long *arr, size_t n, long min, long max);
+
+/**
+    @brief Returns the minimum of array
+
+    @param arr array of numbers
+    @param n amount of numbers
+    @return long : smallest number or LONG_MAX if array is empty
+*/
+long min_long_array(const long *arr, size_t n);
+
+/**
+    @brief Returns the maximum of array
+
+    @param arr array of numbers
+    @param n amount of numbers
+    @return long : largest number or LONG_MIN if array is empty
+*/
+long max_long_array(const long *arr, size_t n);
+
+/**
+    @brief Returns index of the first minimum in array
+
+    @param arr array of numbers
+    @param n amount of numbers
+    @return size_t : index of smallest number or n if array is empty
+*/
+size_t argmin_long_array(const long *arr, size_t n);
+
+/**
+    @brief Returns index of the first maximum in array
+
+    @param arr array of numbers
+    @param n amount of numbers
+    @return size_t : index of largest number or n if array is empty
+*/
+size_t argmax_long_array(const long *arr, size_t n);
+
+/// @brief int32_t version of clamp_long_array
+void clamp_int32_array(int32_t *arr, size_t n, int32_t min, int32_t max);
+/// @brief int32_t version of min_long_array (INT32_MAX if array is empty)
+int32_t min_int32_array(const int32_t *arr, size_t n);
+/// @brief int32_t version of max_long_array (INT32_MIN if array is empty)
+int32_t max_int32_array(const int32_t *arr, size_t n);
+/// @brief int32_t version of argmin_long_array
+size_t argmin_int32_array(const int32_t *arr, size_t n);
+/// @brief int32_t version of argmax_long_array
+size_t argmax_int32_array(const int32_t *arr, size_t n);
+
+/// @brief int64_t version of clamp_long_array
+void clamp_int64_array(int64_t *arr, size_t n, int64_t min, int64_t max);
+/// @brief int64_t version of min_long_array (INT64_MAX if array is empty)
+int64_t min_int64_array(const int64_t *arr, size_t n);
+/// @brief int64_t version of max_long_array (INT64_MIN if array is empty)
+int64_t max_int64_array(const int64_t *arr, size_t n);
+/// @brief int64_t version of argmin_long_array
+size_t argmin_int64_array(const int64_t *arr, size_t n);
+/// @brief int64_t version of argmax_long_array
+size_t argmax_int64_array(const int64_t *arr, size_t n);
+
+/// @brief double version of clamp_long_array (NaN stays NaN)
+void clamp_double_array(double *arr, size_t n, double min, double max);
+/// @brief double version of min_long_array (NaN is skipped, INFINITY if there are no other numbers)
+double min_double_array(const double *arr, size_t n);
+/// @brief double version of max_long_array (NaN is skipped, -INFINITY if there are no other numbers)
+double max_double_array(const double *arr, size_t n);
+/// @brief double version of argmin_long_array (NaN is skipped, n if there are only NaNs)
+size_t argmin_double_array(const double *arr, size_t n);
+/// @brief double version of argmax_long_array (NaN is skipped, n if there are only NaNs)
+size_t argmax_double_array(const double *arr, size_t n);
 
 /**
     @brief Checks if str consist only form digits
@@ -162,8 +706,59 @@ bool is_number(const char *str);
 */
 void str_reverse(char *str);
 
+/**
+    @brief Reverses first len chars of the string (does not look for terminating zero)
+
+    @param str string that will reversed
+    @param len amount of chars to reverse
+*/
+void str_reverse_n(char *str, const size_t len);
+
+/**
+    @brief Copies string into dest in reverse order and terminates it
+
+    @param dest buffer of at least len + 1 bytes, must not overlap with src
+    @param src string to copy from
+    @param len amount of chars to copy
+    @return char* : dest
+*/
+char *str_reverse_copy(char *dest, const char *src, const size_t len);
+
+/**
+    @brief Checks that text is valid UTF-8 (vectorized)
+
+    @param str text to check, may contain zeros
+    @param len amount of bytes to check
+    @return true if text is valid UTF-8
+*/
+bool utf8_validate(const char *str, const size_t len);
+
+/**
+    @brief Counts code points in valid UTF-8 text (vectorized)
+
+    @param str text
+    @param len amount of bytes
+    @return size_t : amount of code points
+*/
+size_t utf8_length(const char *str, const size_t len);
+
+/**
+    @brief Creates dynamic string using global allocator
+
+    @param str initial text, if NULL string is empty
+    @return dynamic_string* : new dynamic string or NULL
+*/
 dynamic_string *DS_init(char *str);
 
+/**
+    @brief Creates dynamic string that uses given allocator for all its memory
+
+    @param str initial text, if NULL string is empty
+    @param allocator allocator of the string
+    @return dynamic_string* : new dynamic string or NULL
+*/
+dynamic_string *DS_init_alloc(char *str, const lw_allocator *allocator);
+
 /**
     @brief Reallocs dynamic_string using new size
 
@@ -173,12 +768,40 @@ dynamic_string *DS_init(char *str);
 dynamic_string *DS_realloc(dynamic_string *dest, const size_t mem_size);
 
 /**
-    @brief Frees memory for dynamic string
+    @brief Frees memory for dynamic string, shared buffer is free'd by last holder
 
     @param ds Dynamic string that will free'd
 */
 void DS_free(dynamic_string *ds);
 
+/**
+    @brief Creates new dynamic string that shares text buffer with ds in O(1) without copying
+
+    Buffer is reference counted with atomics and is copied on first modifying DS_* call of any holder,
+    so holders can be passed to other threads and lists. Single dynamic_string must not be used by
+    several threads at once, give each of them its own DS_share.
+
+    @param ds Dynamic string to share
+    @return dynamic_string* : new dynamic string that must be free'd with DS_free or NULL
+*/
+dynamic_string *DS_share(dynamic_string *ds);
+
+/**
+    @brief Checks if buffer of dynamic string is currently held by other dynamic strings too
+
+    @param ds Dynamic string
+    @return true if buffer is shared
+*/
+bool DS_is_shared(const dynamic_string *ds);
+
+/**
+    @brief Reverses dynamic string in place using its stored length
+
+    @param ds Dynamic string that will be reversed
+    @return dynamic_string* : ds
+*/
+dynamic_string *DS_reverse(dynamic_string *ds);
+
 /**
     @brief Puts text into dynamic_string and resizes it accordingly
 
@@ -214,12 +837,86 @@ dynamic_string *DS_append_char(dynamic_string *dest, const char src);
     @return dynamic_string* 
 */
 dynamic_string *DS_insert_text(dynamic_string *dest, const char *src, const size_t pos);
+/**
+    @brief Finds first occurrence of text in dynamic string (vectorized)
+
+    @param ds Dynamic string to search in
+    @param needle text to find, empty text matches at pos
+    @param pos Position from which search starts
+    @return size_t : position of the match or DS_NPOS
+*/
+size_t DS_find(const dynamic_string *ds, const char *needle, const size_t pos);
+/**
+    @brief Finds first char of dynamic string that is in the set (vectorized)
+
+    @param ds Dynamic string to search in
+    @param set chars to look for
+    @param pos Position from which search starts
+    @return size_t : position of the char or DS_NPOS
+*/
+size_t DS_find_any(const dynamic_string *ds, const char *set, const size_t pos);
+/**
+    @brief Splits dynamic string by delimiters into views that point into its buffer (nothing is copied or modified)
+
+    Views stay valid until the string is modified. Call with views = NULL and max_views = 0 to count fields.
+
+    @param ds Dynamic string to split
+    @param delims every char of it is a delimiter
+    @param skip_empty if true then empty fields between adjacent delimiters are skipped like strtok does
+    @param views array that receives at most max_views views
+    @param max_views size of views array
+    @return size_t : total amount of fields, can be bigger than max_views
+*/
+size_t DS_split(const dynamic_string *ds, const char *delims, bool skip_empty,
+                string_view *views, const size_t max_views);
+/**
+    @brief Replaces every non overlapping occurrence of pattern, result size is computed first and text is written in one pass
+
+    @param dest Dynamic string that will be modified
+    @param pattern text to replace, must not be empty
+    @param replacement text to put instead
+    @return dynamic_string* : Modified dynamic string
+*/
+dynamic_string *DS_replace_all(dynamic_string *dest, const char *pattern, const char *replacement);
+/**
+    @brief Checks that dynamic string is valid UTF-8
+
+    @param ds Dynamic string to check
+    @return true if text is valid UTF-8
+*/
+bool DS_validate_utf8(const dynamic_string *ds);
+/**
+    @brief Counts code points in dynamic string, O(1) if index is built
+
+    @param ds Dynamic string with valid UTF-8 text
+    @return size_t : amount of code points
+*/
+size_t DS_utf8_length(const dynamic_string *ds);
+/**
+    @brief Builds sparse code point index of dynamic string so DS_utf8_offset does not scan from the start
+
+    Index keeps offset of every 64th code point and is dropped by any modification of the string.
+
+    @param ds Dynamic string with valid UTF-8 text
+    @return true if index is built
+*/
+bool DS_utf8_index(dynamic_string *ds);
+/**
+    @brief Finds byte offset of code point
+
+    @param ds Dynamic string with valid UTF-8 text
+    @param index index of code point
+    @return size_t : byte offset, length of string if index is amount of code points or DS_NPOS if it is bigger
+*/
+size_t DS_utf8_offset(const dynamic_string *ds, const size_t index);
 /**
     @brief Miltiplies two strings and returns result as dynamic string
 
+    Numbers are multiplied in limbs of 9 digits, long ones with Karatsuba method.
+
     @param result_str Dynamic string that will hold results of multiplication
-    @param str1 First string containing number
-    @param str2 Second string containing number
+    @param str1 First string containing integer with optional sign
+    @param str2 Second string containing integer with optional sign
     @return dynamic_string* : result_str
 */
 dynamic_string *multiply_strings(dynamic_string *result_str, const char *str1, const char *str2);
@@ -238,6 +935,8 @@ dynamic_string *multiply_string_by_digit(dynamic_string *result, const char *str
                                              int digit, bool keep_reversed);
 /**
     @brief Sums two strings (uses buffers, so you can pass the string from 'result', DOES NOT SUPPORT NEGATIVE NUMBERS YET)
+
+    Signed numbers can be added with subtract_strings(result, a, -b).
     
     @param result Dynamic string that will hold results of addition
     @param str1 First string containing number
@@ -251,6 +950,50 @@ dynamic_string *multiply_string_by_digit(dynamic_string *result, const char *str
 dynamic_string *sum_strings(dynamic_string *result, const char *str1, const size_t len1,
                             const char *str2, const size_t len2, size_t offset, bool using_reversed);
 
+/**
+    @brief Subtracts two signed integers
+
+    @param result Dynamic string that will hold str1 - str2
+    @param str1 Integer with optional sign
+    @param str2 Integer with optional sign
+    @return dynamic_string* : result, on invalid arguments it is not modified and errno is set to EINVAL
+*/
+dynamic_string *subtract_strings(dynamic_string *result, const char *str1, const char *str2);
+
+/**
+    @brief Divides two signed integers, quotient is truncated toward zero and remainder has sign of dividend (as in C)
+
+    Divisors of up to 18 digits use single pass with 64 bit arithmetic, longer ones use schoolbook long division
+    and when both divisor and quotient are long, multiplication by reciprocal computed with Newton iteration.
+
+    @param quotient Dynamic string for quotient or NULL
+    @param remainder Dynamic string for remainder or NULL
+    @param dividend Integer with optional sign
+    @param divisor Integer with optional sign
+    @return true if success, false on invalid arguments (errno is EINVAL) or division by zero (errno is EDOM)
+*/
+bool divide_strings(dynamic_string *quotient, dynamic_string *remainder, const char *dividend,
+                    const char *divisor);
+
+/**
+    @brief Sets size from which divide_strings switches from schoolbook to Newton division
+
+    @param digits Newton division is used when both divisor and quotient have more digits than this,
+    SIZE_MAX disables it
+    @return size_t : previous value
+*/
+size_t lw_set_newton_division_digits(size_t digits);
+
+/**
+    @brief Remainder of division of two signed integers, it has sign of dividend
+
+    @param result Dynamic string that will hold remainder
+    @param dividend Integer with optional sign
+    @param divisor Integer with optional sign
+    @return dynamic_string* : result
+*/
+dynamic_string *modulo_strings(dynamic_string *result, const char *dividend, const char *divisor);
+
 /**
     @brief Get a random double
     
@@ -1,7 +1,19 @@
 // Copyright 2021 <lwolmer>
 #include <check.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
 #include "lw_utils.h"
+#include "lw_containers.h"
+
+#define INT_LESS(a, b) ((a) < (b))
+LW_DEFINE_VECTOR(int_vec, int)
+LW_DEFINE_VECTOR_SORT(int_vec, int, INT_LESS)
+LW_DEFINE_LIST(int_list, int)
+LW_DEFINE_MAP(int_map, int, int, lw_hash_int, lw_eq_int)
+LW_DEFINE_MAP(str_map, const char *, size_t, lw_hash_str, lw_eq_str)
 
 START_TEST(list_add_default) {
     list *test_list = NULL;
@@ -93,10 +105,67 @@ START_TEST(multiply_strings_default) {
     check_DS(str, "0");
     multiply_strings(str, "11111", "11111");
     check_DS(str, "123454321");
+    multiply_strings(str, "123", "10");
+    check_DS(str, "1230");
+    multiply_strings(str, "10", "123");
+    check_DS(str, "1230");
+    multiply_strings(str, "1005", "1020");
+    check_DS(str, "1025100");
+    multiply_strings(str, "0", "0");
+    check_DS(str, "0");
+    multiply_strings(str, "-12", "3");
+    check_DS(str, "-36");
+    multiply_strings(str, "12", "-3");
+    check_DS(str, "-36");
+    multiply_strings(str, "-12", "-003");
+    check_DS(str, "36");
+    multiply_strings(str, "5", "-0");
+    check_DS(str, "0");
     DS_free(str);
 }
 END_TEST
 
+START_TEST(multiply_strings_karatsuba) {
+    const size_t sizes[][2] = {{297, 297}, {600, 590}, {1000, 300}, {300, 1000}};
+    dynamic_string *product = DS_init(NULL);
+    dynamic_string *quotient = DS_init(NULL);
+    dynamic_string *remainder = DS_init(NULL);
+    char *expected = malloc(2 * 1000 + 1);
+    char a[1001], b[1001];
+    unsigned int seed = 23;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        // (10^n - 1)^2 = 99..9800..01 carries through every limb
+        const size_t n = sizes[i][0];
+        memset(a, '9', n);
+        a[n] = 0;
+        memset(expected, '9', n - 1);
+        expected[n - 1] = '8';
+        memset(expected + n, '0', n - 1);
+        expected[2 * n - 1] = '1';
+        expected[2 * n] = 0;
+        multiply_strings(product, a, a);
+        check_DS(product, expected);
+        for (size_t j = 0; j < sizes[i][0]; j++)
+            a[j] = '0' + (j ? rand_r(&seed) % 10 : 1 + rand_r(&seed) % 9);
+        for (size_t j = 0; j < sizes[i][1]; j++)
+            b[j] = '0' + (j ? rand_r(&seed) % 10 : 1 + rand_r(&seed) % 9);
+        a[sizes[i][0]] = 0;
+        b[sizes[i][1]] = 0;
+        multiply_strings(product, a, b);
+        // schoolbook division does not multiply, so it checks the product
+        size_t previous = lw_set_newton_division_digits(SIZE_MAX);
+        ck_assert(divide_strings(quotient, remainder, product->string, b));
+        lw_set_newton_division_digits(previous);
+        check_DS(quotient, a);
+        check_DS(remainder, "0");
+    }
+    free(expected);
+    DS_free(product);
+    DS_free(quotient);
+    DS_free(remainder);
+}
+END_TEST
+
 START_TEST(multiply_string_by_digit_default) {
     dynamic_string *str = DS_init(NULL);
     multiply_string_by_digit(str, "123456789", 9, 9, false);
@@ -127,6 +196,116 @@ START_TEST(sum_strings_default) {
 }
 END_TEST
 
+START_TEST(subtract_strings_default) {
+    dynamic_string *str = DS_init(NULL);
+    subtract_strings(str, "10", "1");
+    check_DS(str, "9");
+    subtract_strings(str, "1", "10");
+    check_DS(str, "-9");
+    subtract_strings(str, "-5", "-5");
+    check_DS(str, "0");
+    subtract_strings(str, "-5", "+7");
+    check_DS(str, "-12");
+    subtract_strings(str, "5", "-0007");
+    check_DS(str, "12");
+    subtract_strings(str, "1000000000000000000000", "1");
+    check_DS(str, "999999999999999999999");
+    subtract_strings(str, "12345678901234567890123", "98765432109876543210987");
+    check_DS(str, "-86419753208641975320864");
+    errno = 0;
+    subtract_strings(str, "12-3", "1");
+    ck_assert_int_eq(errno, EINVAL);
+    check_DS(str, "-86419753208641975320864");
+    DS_free(str);
+}
+END_TEST
+
+START_TEST(divide_strings_default) {
+    dynamic_string *quotient = DS_init(NULL);
+    dynamic_string *remainder = DS_init(NULL);
+    ck_assert(divide_strings(quotient, remainder, "7", "2"));
+    check_DS(quotient, "3");
+    check_DS(remainder, "1");
+    ck_assert(divide_strings(quotient, remainder, "-7", "2"));
+    check_DS(quotient, "-3");
+    check_DS(remainder, "-1");
+    ck_assert(divide_strings(quotient, remainder, "7", "-2"));
+    check_DS(quotient, "-3");
+    check_DS(remainder, "1");
+    ck_assert(divide_strings(quotient, remainder, "-6", "-2"));
+    check_DS(quotient, "3");
+    check_DS(remainder, "0");
+    ck_assert(divide_strings(quotient, remainder, "5", "123"));
+    check_DS(quotient, "0");
+    check_DS(remainder, "5");
+    ck_assert(divide_strings(quotient, NULL, "98765432109876543210987654321098765432109876543210",
+                             "123456789012345678901234567"));
+    check_DS(quotient, "800000007290000066339000");
+    modulo_strings(remainder, "98765432109876543210987654321098765432109876543210",
+                   "123456789012345678901234567");
+    check_DS(remainder, "75241098779373109936330210");
+    ck_assert(divide_strings(quotient, remainder, "10000000000000000000000000000000000000000",
+                             "100000000000000000001"));
+    check_DS(quotient, "99999999999999999999");
+    check_DS(remainder, "1");
+    ck_assert(divide_strings(quotient, remainder, "18446744073709551615", "999999999999999999"));
+    check_DS(quotient, "18");
+    check_DS(remainder, "446744073709551633");
+    // outputs can hold the arguments
+    DS_set_text(quotient, "-5");
+    ck_assert(divide_strings(quotient, remainder, quotient->string, "1000"));
+    check_DS(quotient, "0");
+    check_DS(remainder, "-5");
+    DS_set_text(remainder, "98765432109876543210987654321098765432109876543210");
+    ck_assert(divide_strings(quotient, remainder, remainder->string, "123456789012345678901234567"));
+    check_DS(quotient, "800000007290000066339000");
+    check_DS(remainder, "75241098779373109936330210");
+    DS_set_text(quotient, "123");
+    ck_assert(divide_strings(quotient, remainder, "-1000", quotient->string));
+    check_DS(quotient, "-8");
+    check_DS(remainder, "-16");
+    errno = 0;
+    ck_assert(!divide_strings(quotient, remainder, "5", "-0"));
+    ck_assert_int_eq(errno, EDOM);
+    DS_free(quotient);
+    DS_free(remainder);
+}
+END_TEST
+
+START_TEST(divide_strings_newton) {
+    const size_t sizes[][2] = {{45, 22}, {60, 25}, {100, 45}, {130, 60}};
+    dynamic_string *quotient = DS_init(NULL);
+    dynamic_string *remainder = DS_init(NULL);
+    dynamic_string *expected_quotient = DS_init(NULL);
+    dynamic_string *expected_remainder = DS_init(NULL);
+    char dividend[140], divisor[70];
+    unsigned int seed = 17;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        for (int round = 0; round < 5; round++) {
+            for (size_t j = 0; j < sizes[i][0]; j++)
+                dividend[j + 1] = '0' + (j ? rand_r(&seed) % 10 : 1 + rand_r(&seed) % 9);
+            for (size_t j = 0; j < sizes[i][1]; j++)
+                divisor[j] = '0' + (j ? rand_r(&seed) % 10 : 1 + rand_r(&seed) % 9);
+            dividend[0] = round % 2 ? '-' : '+';
+            dividend[sizes[i][0] + 1] = 0;
+            divisor[sizes[i][1]] = 0;
+            // schoolbook division is the reference for reciprocal based one
+            size_t previous = lw_set_newton_division_digits(SIZE_MAX);
+            ck_assert(divide_strings(expected_quotient, expected_remainder, dividend, divisor));
+            lw_set_newton_division_digits(20);
+            ck_assert(divide_strings(quotient, remainder, dividend, divisor));
+            lw_set_newton_division_digits(previous);
+            check_DS(quotient, expected_quotient->string);
+            check_DS(remainder, expected_remainder->string);
+        }
+    }
+    DS_free(quotient);
+    DS_free(remainder);
+    DS_free(expected_quotient);
+    DS_free(expected_remainder);
+}
+END_TEST
+
 START_TEST(DS_append_char_default) {
     dynamic_string *str = DS_init(NULL);
     DS_append_char(str, 'a');
@@ -160,6 +339,737 @@ START_TEST(DS_insert_text_default) {
 }
 END_TEST
 
+START_TEST(str_reverse_default) {
+    char str[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ!";
+    str_reverse(str);
+    ck_assert_str_eq(str, "!ZYXWVUTSRQPONMLKJIHGFEDCBAzyxwvutsrqponmlkjihgfedcba9876543210");
+    str_reverse_n(str, 5);
+    ck_assert_str_eq(str, "WXYZ!VUTSRQPONMLKJIHGFEDCBAzyxwvutsrqponmlkjihgfedcba9876543210");
+    char odd[] = "abc";
+    str_reverse(odd);
+    ck_assert_str_eq(odd, "cba");
+    char empty[] = "";
+    str_reverse(empty);
+    ck_assert_str_eq(empty, "");
+}
+END_TEST
+
+START_TEST(str_reverse_copy_default) {
+    char *src = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char dest[64] = {0};
+    str_reverse_copy(dest, src, strlen(src));
+    ck_assert_str_eq(dest, "ZYXWVUTSRQPONMLKJIHGFEDCBAzyxwvutsrqponmlkjihgfedcba9876543210");
+    str_reverse_copy(dest, src, 3);
+    ck_assert_str_eq(dest, "210");
+}
+END_TEST
+
+START_TEST(DS_reverse_default) {
+    dynamic_string *str = DS_init("123456789qwoeiwfmpwe,pocjetnbem[qoetm qpbwe[[pr");
+    DS_reverse(str);
+    check_DS(str, "rp[[ewbpq mteoq[mebntejcop,ewpmfwieowq987654321");
+    DS_set_char(str, 0, 3);
+    DS_append_char(str, 'x');
+    DS_reverse(str);
+    check_DS(str, "x[pr");
+    DS_free(str);
+}
+END_TEST
+
+START_TEST(DS_find_default) {
+    char text[200];
+    unsigned int seed = 3;
+    for (size_t i = 0; i < sizeof(text) - 1; i++)
+        text[i] = 'a' + rand_r(&seed) % 3;
+    text[sizeof(text) - 1] = 0;
+    dynamic_string *str = DS_init(text);
+    const char *needles[] = {"", "a", "ab", "cab", "abcabc", "cccc", "aaaaaaaaaaaaaaaaaaa", "d"};
+    for (size_t n = 0; n < sizeof(needles) / sizeof(*needles); n++) {
+        for (size_t pos = 0; pos < str->length; pos += 7) {
+            char *found = strstr(text + pos, needles[n]);
+            ck_assert_uint_eq(DS_find(str, needles[n], pos), found ? (size_t)(found - text) : DS_NPOS);
+            found = strpbrk(text + pos, needles[n]);
+            ck_assert_uint_eq(DS_find_any(str, needles[n], pos), found ? (size_t)(found - text) : DS_NPOS);
+        }
+    }
+    ck_assert_uint_eq(DS_find(str, "a", str->length + 1), DS_NPOS);
+    DS_set_text(str, "0123456789abcdefghijklmnopqrstuvwxyz,;");
+    ck_assert_uint_eq(DS_find_any(str, ";,zyxwvutsrq", 0), 26);
+    ck_assert_uint_eq(DS_find(str, "yz,;", 0), 34);
+    DS_free(str);
+}
+END_TEST
+
+START_TEST(DS_split_default) {
+    dynamic_string *str = DS_init(",one,,two;three,");
+    string_view views[4];
+    ck_assert_uint_eq(DS_split(str, ",;", false, NULL, 0), 6);
+    ck_assert_uint_eq(DS_split(str, ",;", true, views, 4), 3);
+    ck_assert_uint_eq(views[0].length, 3);
+    ck_assert_int_eq(strncmp(views[0].data, "one", 3), 0);
+    ck_assert_int_eq(strncmp(views[1].data, "two", views[1].length), 0);
+    ck_assert_int_eq(strncmp(views[2].data, "three", views[2].length), 0);
+    ck_assert_ptr_eq(views[2].data, str->string + 10);
+    ck_assert_uint_eq(DS_split(str, ",;", false, views, 4), 6);
+    ck_assert_uint_eq(views[0].length, 0);
+    ck_assert_uint_eq(views[2].length, 0);
+    check_DS(str, ",one,,two;three,");
+    // sets longer than 8 bytes are matched with lookup table
+    ck_assert_uint_eq(DS_split(str, "abcdfgijk;,", true, views, 4), 3);
+    ck_assert_int_eq(strncmp(views[2].data, "three", views[2].length), 0);
+    DS_set_text(str, "");
+    ck_assert_uint_eq(DS_split(str, ",", false, views, 4), 1);
+    ck_assert_uint_eq(DS_split(str, ",", true, views, 4), 0);
+    DS_free(str);
+}
+END_TEST
+
+START_TEST(DS_replace_all_default) {
+    dynamic_string *str = DS_init("a-b--c---d");
+    DS_replace_all(str, "--", "+");
+    check_DS(str, "a-b+c+-d");
+    DS_replace_all(str, "-", "<->");
+    check_DS(str, "a<->b+c+<->d");
+    DS_replace_all(str, "<->", "");
+    check_DS(str, "ab+c+d");
+    DS_replace_all(str, "+", "=");
+    check_DS(str, "ab=c=d");
+    DS_replace_all(str, "x", "yyy");
+    check_DS(str, "ab=c=d");
+    DS_replace_all(str, "", "yyy");
+    check_DS(str, "ab=c=d");
+    DS_set_text(str, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    DS_replace_all(str, "a", "bb");
+    ck_assert_uint_eq(str->length, 80);
+    ck_assert_uint_eq(DS_find(str, "a", 0), DS_NPOS);
+    // growing replacement of shared text leaves the other owner intact
+    dynamic_string *copy = DS_share(str);
+    DS_replace_all(copy, "b", "<b>");
+    ck_assert_uint_eq(copy->length, 240);
+    ck_assert_uint_eq(DS_find(copy, "<b><b>", 234), 234);
+    ck_assert_uint_eq(str->length, 80);
+    ck_assert_uint_eq(DS_find(str, "<", 0), DS_NPOS);
+    DS_free(copy);
+    DS_free(str);
+}
+END_TEST
+
+START_TEST(DS_share_default) {
+    dynamic_string *str = DS_init("shared text");
+    dynamic_string *copy = DS_share(str);
+    ck_assert_ptr_eq(copy->string, str->string);
+    ck_assert(DS_is_shared(str) && DS_is_shared(copy));
+    DS_append_char(copy, '!');
+    check_DS(copy, "shared text!");
+    check_DS(str, "shared text");
+    ck_assert(!DS_is_shared(str) && !DS_is_shared(copy));
+    dynamic_string *copy2 = DS_share(str);
+    dynamic_string *copy3 = DS_share(copy2);
+    DS_set_text(str, str->string + 7);
+    DS_insert_text(copy2, "big ", 7);
+    DS_replace_all(copy3, "text", "");
+    check_DS(str, "text");
+    check_DS(copy2, "shared big text");
+    check_DS(copy3, "shared ");
+    DS_free(copy3);
+    copy3 = DS_share(copy2);
+    DS_free(copy2);
+    // last holder modifies buffer in place
+    char *buffer = copy3->string;
+    DS_reverse(copy3);
+    ck_assert_ptr_eq(copy3->string, buffer);
+    check_DS(copy3, "txet gib derahs");
+    DS_free(copy3);
+    DS_free(copy);
+    DS_free(str);
+}
+END_TEST
+
+#define DS_SHARE_THREADS 4
+
+void *DS_share_worker(void *arg) {
+    dynamic_string *str = arg;
+    for (int i = 0; i < 100; i++) {
+        dynamic_string *copy = DS_share(str);
+        if (i % 2)
+            DS_append_char(copy, 'x');
+        if (strncmp(copy->string, "0123456789", 10) != 0)
+            return arg;
+        DS_free(copy);
+    }
+    DS_free(str);
+    return NULL;
+}
+
+START_TEST(DS_share_concurrent) {
+    dynamic_string *str = DS_init("0123456789");
+    pthread_t threads[DS_SHARE_THREADS];
+    for (size_t i = 0; i < DS_SHARE_THREADS; i++)
+        pthread_create(&threads[i], NULL, DS_share_worker, DS_share(str));
+    DS_free(str);
+    for (size_t i = 0; i < DS_SHARE_THREADS; i++) {
+        void *result = NULL;
+        pthread_join(threads[i], &result);
+        ck_assert_ptr_eq(result, NULL);
+    }
+}
+END_TEST
+
+START_TEST(utf8_validate_default) {
+    const char *valid[] = {"", "ascii only", "\xC2\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+                           "\xF4\x8F\xBF\xBF", "\xED\x9F\xBF", "\xEF\xBF\xBF"};
+    const char *invalid[] = {"\x80", "\xC0\xAF", "\xC2", "\xE0\x9F\xBF", "\xED\xA0\x80", "\xF0\x8F\xBF\xBF",
+                             "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xE2\x82", "\xC2\xA9\xA9", "\xFF"};
+    char text[100];
+    for (int level = LW_SIMD_SCALAR; level <= LW_SIMD_AVX2; level++) {
+        lw_set_simd_level(level);
+        // every sequence at every position of 16 and 32 byte blocks
+        for (size_t prefix = 0; prefix < 40; prefix++) {
+            memset(text, 'a', prefix);
+            for (size_t i = 0; i < sizeof(valid) / sizeof(*valid); i++) {
+                strcpy(text + prefix, valid[i]);
+                ck_assert(utf8_validate(text, strlen(text)));
+                strcat(text, "tail");
+                ck_assert(utf8_validate(text, strlen(text)));
+            }
+            for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); i++) {
+                strcpy(text + prefix, invalid[i]);
+                ck_assert(!utf8_validate(text, strlen(text)));
+                strcat(text, "\xC2\xA9 tail that is long enough to be in the next block");
+                ck_assert(!utf8_validate(text, strlen(text)));
+            }
+        }
+    }
+    // random mutations of valid text must give same answer as scalar validator
+    const char *sample = "z\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xED\x9F\xBF" "abc\xC2\xA9";
+    unsigned int seed = 11;
+    for (int round = 0; round < 2000; round++) {
+        size_t len = 0;
+        while (len + 20 < sizeof(text)) {
+            strcpy(text + len, sample + rand_r(&seed) % 3);
+            len = strlen(text);
+        }
+        text[rand_r(&seed) % len] = rand_r(&seed) % 256;
+        lw_set_simd_level(LW_SIMD_SCALAR);
+        bool expected = utf8_validate(text, len);
+        size_t expected_length = utf8_length(text, len);
+        for (int level = LW_SIMD_SSE4; level <= LW_SIMD_AVX2; level++) {
+            lw_set_simd_level(level);
+            ck_assert_int_eq(utf8_validate(text, len), expected);
+            ck_assert_uint_eq(utf8_length(text, len), expected_length);
+        }
+    }
+    lw_set_simd_level(LW_SIMD_AVX2);
+}
+END_TEST
+
+START_TEST(DS_utf8_index_default) {
+    dynamic_string *str = DS_init(NULL);
+    for (int i = 0; i < 100; i++)
+        DS_insert_text(str, i % 2 ? "\xE2\x82\xAC" : "a\xC3\xA9", str->length);
+    ck_assert(DS_validate_utf8(str));
+    ck_assert_uint_eq(DS_utf8_length(str), 150);
+    size_t offsets[151];
+    for (size_t i = 0; i <= 150; i++)
+        offsets[i] = DS_utf8_offset(str, i);
+    ck_assert_uint_eq(offsets[3], 6);
+    ck_assert_uint_eq(offsets[150], str->length);
+    ck_assert_uint_eq(DS_utf8_offset(str, 151), DS_NPOS);
+    ck_assert(DS_utf8_index(str));
+    ck_assert_ptr_ne(str->utf8_index, NULL);
+    ck_assert_uint_eq(DS_utf8_length(str), 150);
+    for (size_t i = 0; i <= 150; i++)
+        ck_assert_uint_eq(DS_utf8_offset(str, i), offsets[i]);
+    ck_assert_uint_eq(DS_utf8_offset(str, 151), DS_NPOS);
+    DS_append_char(str, 'x');
+    ck_assert_ptr_eq(str->utf8_index, NULL);
+    ck_assert_uint_eq(DS_utf8_length(str), 151);
+    DS_set_char(str, (char)0xFF, 0);
+    ck_assert(!DS_validate_utf8(str));
+    DS_free(str);
+}
+END_TEST
+
+START_TEST(list_add_from_file_utf8) {
+    char path[] = "/tmp/lw_utils_test_XXXXXX";
+    int fd = mkstemp(path);
+    ck_assert_int_ne(fd, -1);
+    FILE *file = fdopen(fd, "w");
+    fputs("first\n\xC3\xA9t\xC3\xA9\n\xC3\x28 bad\nlast\n", file);
+    fclose(file);
+    list *lines = NULL;
+    list_load_options options = {.validate_utf8 = true};
+    ck_assert_int_eq(list_add_from_file_opts(&lines, path, &options), EILSEQ);
+    ck_assert_uint_eq(options.error_line, 3);
+    ck_assert_uint_eq(list_get_length(lines), 2);
+    list_free(&lines);
+    options.validate_utf8 = false;
+    ck_assert_int_eq(list_add_from_file_opts(&lines, path, &options), 0);
+    ck_assert_uint_eq(options.error_line, 0);
+    list_free(&lines);
+    remove(path);
+}
+END_TEST
+
+START_TEST(intern_default) {
+    lw_counting_allocator *counter = lw_counting_allocator_create(NULL);
+    lw_intern_table *table = lw_intern_table_create(lw_counting_allocator_get(counter));
+    char key[32];
+    const char *first[100];
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 100; i++) {
+            int len = snprintf(key, sizeof(key), "key-%d", i);
+            const char *interned = lw_intern(table, key, len);
+            ck_assert_str_eq(interned, key);
+            if (round == 0)
+                first[i] = interned;
+            else
+                ck_assert_ptr_eq(interned, first[i]);
+        }
+    }
+    ck_assert_ptr_eq(lw_intern(table, "key-1 and more", 5), first[1]);
+    ck_assert_str_eq(lw_intern(table, "", 0), "");
+    lw_intern_stats stats = lw_intern_table_stats(table);
+    ck_assert_uint_eq(stats.unique, 101);
+    ck_assert_uint_eq(stats.total, 302);
+    ck_assert_uint_eq(stats.bytes, 10 * 6 + 90 * 7 + 1);
+    ck_assert_uint_eq(stats.bytes_saved, 2 * (10 * 6 + 90 * 7) + 6);
+    ck_assert(stats.dedup_ratio > 2.9 && stats.dedup_ratio < 3.0);
+    lw_intern_table_destroy(table);
+    ck_assert_uint_eq(lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS).current, 0);
+    lw_counting_allocator_destroy(counter);
+}
+END_TEST
+
+START_TEST(list_add_from_file_intern) {
+    char path[] = "/tmp/lw_utils_test_XXXXXX";
+    FILE *file = fdopen(mkstemp(path), "w");
+    for (int i = 0; i < 30; i++)
+        fprintf(file, "%s\n", i % 3 ? "INFO" : "ERROR");
+    fclose(file);
+    list *lines = NULL;
+    list_load_options options = {.intern = lw_intern_table_create(NULL)};
+    ck_assert_int_eq(list_add_from_file_opts(&lines, path, &options), 0);
+    ck_assert_uint_eq(list_get_length(lines), 30);
+    ck_assert(!lines->is_dynamic);
+    ck_assert_str_eq(lines->data, "ERROR");
+    ck_assert_ptr_eq(lines->data, lines->next_node->next_node->next_node->data);
+    lw_intern_stats stats = lw_intern_table_stats(options.intern);
+    ck_assert_uint_eq(stats.unique, 2);
+    ck_assert_uint_eq(stats.bytes_saved, 9 * 6 + 19 * 5);
+    list_free(&lines);
+    lw_intern_table_destroy(options.intern);
+    remove(path);
+}
+END_TEST
+
+START_TEST(capp_assert_default) {
+    ck_assert_int_eq(capp_assert("echo 123", "echo 123", true), true);
+    ck_assert_int_eq(capp_assert("echo 123", "echo 124", true), false);
+    ck_assert_int_eq(capp_assert("printf 'a\\nb\\n'", "printf 'a\\nb\\nc\\n'", false), false);
+    // outputs are compared as lines, so newline after the last line doesnt matter
+    ck_assert_int_eq(capp_assert("printf 'a\\nb'", "printf 'a\\nb\\n'", true), true);
+    ck_assert_int_eq(capp_assert("echo a", "printf a", true), true);
+    ck_assert_int_eq(capp_assert("printf 'a\\n\\n'", "printf 'a\\n'", true), false);
+    ck_assert_int_eq(capp_assert("echo", "true", true), false);
+    ck_assert_int_eq(capp_assert("head -c 65535 /dev/zero | tr '\\0' a",
+                                 "head -c 65535 /dev/zero | tr '\\0' a; echo", true), true);
+    ck_assert_int_eq(capp_assert("head -c 65535 /dev/zero | tr '\\0' a; echo b",
+                                 "head -c 65535 /dev/zero | tr '\\0' a; echo", true), false);
+}
+END_TEST
+
+START_TEST(capp_assert_batch_default) {
+    capp_pair pairs[] = {
+        {"echo hello", "echo hello"},
+        {"printf 'a\\nb\\n'", "printf 'a\\nc\\n'"},
+        {"seq 1 100000", "seq 1 100000"},
+        {"seq 1 100000", "seq 1 99999"},
+        {"seq 1 30000 | tr -d '\\n'", "seq 1 30001 | tr -d '\\n'"},
+        {"true", "true"},
+        {"echo a", "printf a"},
+    };
+    size_t count = sizeof(pairs) / sizeof(pairs[0]);
+    capp_result *results = capp_assert_batch(pairs, count, 3);
+    ck_assert_int_eq(results[0].equal, true);
+    ck_assert_int_eq(results[1].equal, false);
+    ck_assert_uint_eq(results[1].line, 2);
+    ck_assert_str_eq(results[1].line1, "b");
+    ck_assert_str_eq(results[1].line2, "c");
+    ck_assert_int_eq(results[2].equal, true);
+    ck_assert_uint_eq(results[2].bytes, 588895);
+    ck_assert_int_eq(results[3].equal, false);
+    ck_assert_uint_eq(results[3].line, 100000);
+    ck_assert_str_eq(results[3].line1, "100000");
+    ck_assert_ptr_eq(results[3].line2, NULL);
+    ck_assert_int_eq(results[4].equal, false);
+    ck_assert_uint_eq(results[4].line, 1);
+    ck_assert_uint_eq(strlen(results[4].line2), strlen(results[4].line1) + 5);
+    ck_assert_int_eq(results[5].equal, true);
+    ck_assert_int_eq(results[5].failed, false);
+    // batch compares byte for byte
+    ck_assert_int_eq(results[6].equal, false);
+    capp_results_free(results, count);
+}
+END_TEST
+
+START_TEST(counting_allocator_default) {
+    lw_counting_allocator *counter = lw_counting_allocator_create(NULL);
+    lw_set_allocator(lw_counting_allocator_get(counter));
+    dynamic_string *str = DS_init("123");
+    multiply_strings(str, "123456789", "987654321");
+    check_DS(str, "121932631112635269");
+    list *test_list = NULL;
+    list_add(&test_list, NULL, false);
+    list_add(&test_list, NULL, false);
+    lw_mem_stats stats = lw_counting_allocator_stats(counter, LW_MEM_LIST);
+    ck_assert_uint_eq(stats.allocations, 2);
+    ck_assert_uint_eq(stats.current, 2 * sizeof(list));
+    stats = lw_counting_allocator_stats(counter, LW_MEM_NUMBER);
+    ck_assert_uint_gt(stats.allocations, 0);
+    ck_assert_uint_eq(stats.current, 0);
+    list_free(&test_list);
+    DS_free(str);
+    lw_set_allocator(NULL);
+    stats = lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS);
+    ck_assert_uint_eq(stats.current, 0);
+    ck_assert_uint_ge(stats.allocations, stats.frees);
+    ck_assert_uint_gt(lw_counting_allocator_stats(counter, LW_MEM_STRING).peak, 0);
+    lw_counting_allocator_destroy(counter);
+}
+END_TEST
+
+START_TEST(list_add_alloc_default) {
+    lw_counting_allocator *counter = lw_counting_allocator_create(NULL);
+    const lw_allocator *allocator = lw_counting_allocator_get(counter);
+    list *test_list = NULL;
+    for (int i = 0; i < 10; i++) {
+        int *data = allocator->alloc(allocator->context, sizeof(int), LW_MEM_OTHER);
+        *data = i;
+        list_add_alloc(&test_list, data, true, allocator);
+    }
+    ck_assert_uint_eq(list_get_length(test_list), 10);
+    ck_assert_int_eq(*(int *)list_get_last(test_list)->data, 9);
+    list_pop(&test_list);
+    ck_assert_int_eq(*(int *)list_get_last(test_list)->data, 8);
+    list_free(&test_list);
+    lw_mem_stats stats = lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS);
+    ck_assert_uint_eq(stats.allocations, 20);
+    ck_assert_uint_eq(stats.frees, 20);
+    ck_assert_uint_eq(stats.current, 0);
+    ck_assert_uint_eq(stats.bytes, 10 * sizeof(int) + 10 * sizeof(list));
+    // data of list_add is malloc'd by caller and nodes are free'd with allocator they were made with
+    lw_set_allocator(allocator);
+    int *data = malloc(sizeof(int));
+    list_add(&test_list, data, true);
+    lw_set_allocator(NULL);
+    ck_assert_uint_eq(lw_counting_allocator_stats(counter, LW_MEM_LIST).current, sizeof(list));
+    list_free(&test_list);
+    ck_assert_uint_eq(lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS).current, 0);
+    lw_counting_allocator_destroy(counter);
+}
+END_TEST
+
+typedef struct {
+    int value;
+    ilist_link link;
+} ilist_item;
+
+START_TEST(ilist_default) {
+    ilist_item items[10];
+    ilist lst;
+    ilist_init(&lst);
+    for (int i = 0; i < 10; i++) {
+        items[i].value = i;
+        ilist_add(&lst, &items[i].link);
+    }
+    ck_assert_uint_eq(ilist_get_length(&lst), 10);
+    int expected = 0;
+    ILIST_FOREACH(link, &lst)
+        ck_assert_int_eq(LW_CONTAINER_OF(link, ilist_item, link)->value, expected++);
+    ilist_remove(&lst, &items[5].link);
+    ilist_link *last = ilist_pop(&lst);
+    ck_assert_int_eq(LW_CONTAINER_OF(last, ilist_item, link)->value, 9);
+    ck_assert_int_eq(LW_CONTAINER_OF(ilist_get_last(&lst), ilist_item, link)->value, 8);
+    ck_assert_int_eq(LW_CONTAINER_OF(ilist_pop_front(&lst), ilist_item, link)->value, 0);
+    ilist_add_front(&lst, &items[5].link);
+    int order[] = {5, 1, 2, 3, 4, 6, 7, 8};
+    expected = 0;
+    ILIST_FOREACH(link, &lst)
+        ck_assert_int_eq(LW_CONTAINER_OF(link, ilist_item, link)->value, order[expected++]);
+    ck_assert_uint_eq(ilist_get_length(&lst), 8);
+    while (ilist_pop(&lst)) {}
+    ck_assert_ptr_eq(lst.head, NULL);
+    ck_assert_ptr_eq(ilist_pop_front(&lst), NULL);
+}
+END_TEST
+
+START_TEST(lfqueue_default) {
+    lw_counting_allocator *counter = lw_counting_allocator_create(NULL);
+    lfqueue *queue = lfqueue_create(3, lw_counting_allocator_get(counter));
+    int arr[4] = {1, 2, 3, 4};
+    for (size_t i = 0; i < 4; i++)
+        ck_assert_int_eq(lfqueue_push(queue, &arr[i], false), true);
+    ck_assert_int_eq(lfqueue_push(queue, &arr[0], false), false);
+    void *data = NULL;
+    bool is_dynamic = true;
+    for (size_t i = 0; i < 4; i++) {
+        ck_assert_int_eq(lfqueue_pop(queue, &data, &is_dynamic), true);
+        ck_assert_int_eq(*(int *)data, arr[i]);
+        ck_assert_int_eq(is_dynamic, false);
+    }
+    ck_assert_int_eq(lfqueue_pop(queue, &data, NULL), false);
+    // dynamic data is malloc'd by caller, not by allocator of the queue
+    lfqueue_push(queue, malloc(sizeof(int)), true);
+    lfqueue_free(queue);
+    ck_assert_uint_eq(lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS).current, 0);
+    lw_counting_allocator_destroy(counter);
+}
+END_TEST
+
+START_TEST(lfstack_default) {
+    lw_counting_allocator *counter = lw_counting_allocator_create(NULL);
+    lfstack *stack = lfstack_create(4, lw_counting_allocator_get(counter));
+    int arr[4] = {1, 2, 3, 4};
+    for (size_t i = 0; i < 4; i++)
+        ck_assert_int_eq(lfstack_push(stack, &arr[i], false), true);
+    ck_assert_int_eq(lfstack_push(stack, &arr[0], false), false);
+    void *data = NULL;
+    for (size_t i = 0; i < 4; i++) {
+        ck_assert_int_eq(lfstack_pop(stack, &data, NULL), true);
+        ck_assert_int_eq(*(int *)data, arr[3 - i]);
+    }
+    ck_assert_int_eq(lfstack_pop(stack, &data, NULL), false);
+    lfstack_push(stack, malloc(sizeof(int)), true);
+    lfstack_free(stack);
+    ck_assert_uint_eq(lw_counting_allocator_stats(counter, LW_MEM_SUBSYSTEMS).current, 0);
+    lw_counting_allocator_destroy(counter);
+}
+END_TEST
+
+#define LF_THREADS 4
+#define LF_ITEMS 20000
+
+typedef struct {
+    lfqueue *queue;
+    lfstack *stack;
+    size_t sum;
+} lf_worker_args;
+
+void *lf_producer(void *arg) {
+    lf_worker_args *args = arg;
+    for (size_t i = 1; i <= LF_ITEMS; i++) {
+        while (args->queue && !lfqueue_push(args->queue, (void *)i, false)) {}
+        while (args->stack && !lfstack_push(args->stack, (void *)i, false)) {}
+    }
+    return NULL;
+}
+
+void *lf_consumer(void *arg) {
+    lf_worker_args *args = arg;
+    void *data = NULL;
+    for (size_t i = 0; i < LF_ITEMS; i++) {
+        while (args->queue && !lfqueue_pop(args->queue, &data, NULL)) {}
+        if (args->queue)
+            args->sum += (size_t)data;
+        while (args->stack && !lfstack_pop(args->stack, &data, NULL)) {}
+        if (args->stack)
+            args->sum += (size_t)data;
+    }
+    return NULL;
+}
+
+START_TEST(lockfree_concurrent) {
+    lf_worker_args args[2 * LF_THREADS] = {0};
+    pthread_t threads[2 * LF_THREADS];
+    lfqueue *queue = lfqueue_create(64, NULL);
+    lfstack *stack = lfstack_create(64, NULL);
+    for (size_t i = 0; i < 2 * LF_THREADS; i++) {
+        args[i].queue = queue;
+        args[i].stack = stack;
+        pthread_create(&threads[i], NULL, i % 2 ? lf_producer : lf_consumer, &args[i]);
+    }
+    size_t sum = 0;
+    for (size_t i = 0; i < 2 * LF_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        sum += args[i].sum;
+    }
+    ck_assert_uint_eq(sum, (size_t)LF_THREADS * LF_ITEMS * (LF_ITEMS + 1));
+    ck_assert_int_eq(lfqueue_pop(queue, NULL, NULL), false);
+    ck_assert_int_eq(lfstack_pop(stack, NULL, NULL), false);
+    lfqueue_free(queue);
+    lfstack_free(stack);
+}
+END_TEST
+
+START_TEST(int_vec_default) {
+    int_vec vec;
+    int_vec_init(&vec, NULL);
+    unsigned int seed = 1;
+    for (int i = 0; i < 1000; i++)
+        ck_assert_int_eq(int_vec_push(&vec, rand_r(&seed) % 100), true);
+    int_vec_sort(&vec);
+    for (size_t i = 1; i < vec.length; i++)
+        ck_assert_int_ge(*int_vec_at(&vec, i), *int_vec_at(&vec, i - 1));
+    ck_assert_ptr_eq(int_vec_at(&vec, 1000), NULL);
+    int last = -1;
+    ck_assert_int_eq(int_vec_pop(&vec, &last), true);
+    ck_assert_int_eq(last, 99);
+    ck_assert_uint_eq(vec.length, 999);
+    int_vec_free(&vec);
+}
+END_TEST
+
+START_TEST(int_vec_list_conversion) {
+    int arr[5] = {5, 4, 3, 2, 1};
+    list *test_list = NULL;
+    for (size_t i = 0; i < 5; i++)
+        list_add(&test_list, &arr[i], false);
+    int_vec vec;
+    int_vec_init(&vec, NULL);
+    int_vec_from_list(&vec, test_list);
+    list_free(&test_list);
+    ck_assert_uint_eq(vec.length, 5);
+    int_vec_sort(&vec);
+    int_vec_to_list(&vec, &test_list);
+    int_list lst;
+    int_list_init(&lst, NULL);
+    int_list_from_list(&lst, test_list);
+    ck_assert_uint_eq(lst.length, 5);
+    for (int i = 1; i <= 5; i++) {
+        int value = 0;
+        ck_assert_int_eq(int_list_pop_front(&lst, &value), true);
+        ck_assert_int_eq(value, i);
+    }
+    ck_assert_int_eq(int_list_pop_front(&lst, NULL), false);
+    int_list_push_back(&lst, 2);
+    int_list_push_front(&lst, 1);
+    int_list_to_list(&lst, &test_list);
+    ck_assert_uint_eq(list_get_length(test_list), 7);
+    ck_assert_int_eq(*(int *)list_get_last(test_list)->data, 2);
+    list_free(&test_list);
+    int_list_free(&lst);
+    int_vec_free(&vec);
+}
+END_TEST
+
+START_TEST(int_map_default) {
+    int_map map;
+    int_map_init(&map, NULL);
+    for (int i = 0; i < 1000; i++)
+        ck_assert_int_eq(int_map_put(&map, i * 7, i), true);
+    ck_assert_uint_eq(map.length, 1000);
+    for (int i = 0; i < 1000; i += 2)
+        ck_assert_int_eq(int_map_remove(&map, i * 7), true);
+    ck_assert_int_eq(int_map_remove(&map, 0), false);
+    ck_assert_uint_eq(map.length, 500);
+    for (int i = 0; i < 1000; i++) {
+        int *value = int_map_get(&map, i * 7);
+        if (i % 2) {
+            ck_assert_ptr_ne(value, NULL);
+            ck_assert_int_eq(*value, i);
+        } else {
+            ck_assert_ptr_eq(value, NULL);
+        }
+    }
+    int_map_free(&map);
+    str_map words;
+    str_map_init(&words, NULL);
+    const char *text[] = {"INFO", "WARN", "INFO", "ERROR", "INFO"};
+    for (size_t i = 0; i < 5; i++) {
+        size_t *count = str_map_get(&words, text[i]);
+        str_map_put(&words, text[i], count ? *count + 1 : 1);
+    }
+    ck_assert_uint_eq(*str_map_get(&words, "INFO"), 3);
+    ck_assert_uint_eq(*str_map_get(&words, "ERROR"), 1);
+    ck_assert_ptr_eq(str_map_get(&words, "DEBUG"), NULL);
+    list *pairs = NULL;
+    str_map_to_list(&words, &pairs);
+    ck_assert_uint_eq(list_get_length(pairs), 3);
+    str_map copy;
+    str_map_init(&copy, NULL);
+    ck_assert_int_eq(str_map_from_list(&copy, pairs), true);
+    ck_assert_uint_eq(copy.length, 3);
+    ck_assert_uint_eq(*str_map_get(&copy, "INFO"), 3);
+    ck_assert_uint_eq(*str_map_get(&copy, "WARN"), 1);
+    list_free(&pairs);
+    str_map_free(&copy);
+    str_map_free(&words);
+}
+END_TEST
+
+START_TEST(array_kernels_default) {
+    long arr[103];
+    int32_t arr32[103];
+    double arrd[103];
+    unsigned int seed = 7;
+    for (int level = LW_SIMD_SCALAR; level <= LW_SIMD_AVX2; level++) {
+        lw_set_simd_level(level);
+        for (size_t n = 0; n <= 103; n += 17) {
+            long min = LONG_MAX, max = LONG_MIN;
+            size_t argmin = n, argmax = n;
+            for (size_t i = 0; i < n; i++) {
+                arr[i] = (long)rand_r(&seed) - RAND_MAX / 2;
+                arr32[i] = arr[i];
+                arrd[i] = arr[i];
+                if (arr[i] < min) {
+                    min = arr[i];
+                    argmin = i;
+                }
+                if (arr[i] > max) {
+                    max = arr[i];
+                    argmax = i;
+                }
+            }
+            ck_assert_int_eq(min_long_array(arr, n), min);
+            ck_assert_int_eq(max_long_array(arr, n), max);
+            ck_assert_uint_eq(argmin_long_array(arr, n), argmin);
+            ck_assert_uint_eq(argmax_long_array(arr, n), argmax);
+            ck_assert_uint_eq(argmin_int32_array(arr32, n), argmin);
+            ck_assert_uint_eq(argmax_int32_array(arr32, n), argmax);
+            ck_assert_uint_eq(argmin_double_array(arrd, n), argmin);
+            ck_assert_uint_eq(argmax_double_array(arrd, n), argmax);
+            clamp_long_array(arr, n, -1000, 1000);
+            clamp_int32_array(arr32, n, -1000, 1000);
+            clamp_double_array(arrd, n, -1000, 1000);
+            for (size_t i = 0; i < n; i++) {
+                ck_assert_int_eq(arr[i], clamp_long(arr32[i], -1000, 1000));
+                ck_assert_int_eq(arr32[i], arr[i]);
+                ck_assert_double_eq(arrd[i], arr[i]);
+            }
+        }
+    }
+    lw_set_simd_level(LW_SIMD_AVX2);
+}
+END_TEST
+
+START_TEST(array_kernels_nan) {
+    double arr[9] = {NAN, 3, NAN, -2, 5, NAN, -2, 5, NAN};
+    for (int level = LW_SIMD_SCALAR; level <= LW_SIMD_AVX2; level++) {
+        lw_set_simd_level(level);
+        ck_assert_double_eq(min_double_array(arr, 9), -2);
+        ck_assert_double_eq(max_double_array(arr, 9), 5);
+        ck_assert_uint_eq(argmin_double_array(arr, 9), 3);
+        ck_assert_uint_eq(argmax_double_array(arr, 9), 4);
+        ck_assert_uint_eq(argmin_double_array(arr, 1), 1);
+        double clamped[9];
+        memcpy(clamped, arr, sizeof(arr));
+        clamp_double_array(clamped, 9, 0, 4);
+        ck_assert(isnan(clamped[0]) && isnan(clamped[8]));
+        ck_assert_double_eq(clamped[3], 0);
+        ck_assert_double_eq(clamped[4], 4);
+        int64_t arr64[5] = {INT64_MAX, INT64_MIN, 0, -1, INT64_MIN};
+        ck_assert_int_eq(min_int64_array(arr64, 5), INT64_MIN);
+        ck_assert_uint_eq(argmin_int64_array(arr64, 5), 1);
+        ck_assert_uint_eq(argmax_int64_array(arr64, 5), 0);
+        clamp_int64_array(arr64, 5, -5, 5);
+        ck_assert_int_eq(arr64[0], 5);
+        ck_assert_int_eq(arr64[4], -5);
+    }
+    lw_set_simd_level(LW_SIMD_AVX2);
+}
+END_TEST
+
 START_TEST(print_binary_default) {
     char d = CHAR_MAX;
     print_binary(&d, 3);
@@ -178,12 +1088,30 @@ Suite *s21_string_suite(void) {
     // Набор разбивается на группы тестов, разделённых по каким-либо критериям.
     TCase *LST = tcase_create("List");
     tcase_add_test(LST, list_add_default);
+    tcase_add_test(LST, list_add_alloc_default);
+    tcase_add_test(LST, ilist_default);
+    tcase_add_test(LST, list_add_from_file_utf8);
+    tcase_add_test(LST, list_add_from_file_intern);
+
+    TCase *LOCKFREE = tcase_create("Lock-free containers");
+    tcase_add_test(LOCKFREE, lfqueue_default);
+    tcase_add_test(LOCKFREE, lfstack_default);
+    tcase_add_test(LOCKFREE, lockfree_concurrent);
+
+    TCase *CONTAINERS = tcase_create("Type specialized containers");
+    tcase_add_test(CONTAINERS, int_vec_default);
+    tcase_add_test(CONTAINERS, int_vec_list_conversion);
+    tcase_add_test(CONTAINERS, int_map_default);
 
     TCase *STRMULT = tcase_create("String multiplication");
     tcase_add_test(STRMULT, multiply_strings_default);
+    tcase_add_test(STRMULT, multiply_strings_karatsuba);
     tcase_add_test(STRMULT, multiply_string_by_digit_default);
+    tcase_add_test(STRMULT, divide_strings_default);
+    tcase_add_test(STRMULT, divide_strings_newton);
     TCase *STRSUM = tcase_create("String additions");
     tcase_add_test(STRSUM, sum_strings_default);
+    tcase_add_test(STRSUM, subtract_strings_default);
     TCase *DYNSTR = tcase_create("Dynamic string");
     tcase_add_test(DYNSTR, dynamic_string_init_default);
     tcase_add_test(DYNSTR, dynamic_string_set_char_default);
@@ -193,13 +1121,37 @@ Suite *s21_string_suite(void) {
     tcase_add_test(DYNSTR, dynamic_string_set_text_const);
     tcase_add_test(DYNSTR, DS_append_char_default);
     tcase_add_test(DYNSTR, DS_insert_text_default);
+    tcase_add_test(DYNSTR, DS_reverse_default);
+    tcase_add_test(DYNSTR, DS_find_default);
+    tcase_add_test(DYNSTR, DS_split_default);
+    tcase_add_test(DYNSTR, DS_replace_all_default);
+    tcase_add_test(DYNSTR, DS_share_default);
+    tcase_add_test(DYNSTR, DS_share_concurrent);
+    tcase_add_test(DYNSTR, utf8_validate_default);
+    tcase_add_test(DYNSTR, DS_utf8_index_default);
+    TCase *CAPP = tcase_create("Command output assertion");
+    tcase_add_test(CAPP, capp_assert_default);
+    tcase_add_test(CAPP, capp_assert_batch_default);
+    TCase *ALLOC = tcase_create("Allocators");
+    tcase_add_test(ALLOC, counting_allocator_default);
+    tcase_add_test(ALLOC, intern_default);
+    TCase *KERNELS = tcase_create("Array kernels");
+    tcase_add_test(KERNELS, array_kernels_default);
+    tcase_add_test(KERNELS, array_kernels_nan);
     TCase *MISC = tcase_create("Misc");
     tcase_add_test(MISC, print_binary_default);
+    tcase_add_test(MISC, str_reverse_default);
+    tcase_add_test(MISC, str_reverse_copy_default);
     // Добавление теста в тестовый набор.
     suite_add_tcase(suite, LST);
+    suite_add_tcase(suite, LOCKFREE);
+    suite_add_tcase(suite, CONTAINERS);
     suite_add_tcase(suite, STRMULT);
     suite_add_tcase(suite, STRSUM);
     suite_add_tcase(suite, DYNSTR);
+    suite_add_tcase(suite, ALLOC);
+    suite_add_tcase(suite, CAPP);
+    suite_add_tcase(suite, KERNELS);
     suite_add_tcase(suite, MISC);
 
     return suite;